@@ -2,11 +2,14 @@
 #define ADAPTIVE_PREDICTIVE_CACHE_H
 
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <chrono>
 #include <cmath> // For std::log1p
 #include <limits> // For std::numeric_limits
-#include <vector> // Potentially for handling multiple eviction candidates or iteration
+#include <vector> // Eviction pool
+#include <random>
+#include <optional>
+#include "Dict.h"
 
 struct KeyStats {
     int access_count = 0;
@@ -18,11 +21,30 @@ struct KeyStats {
 
 class AdaptivePredictiveCache {
 private:
-    std::unordered_map<std::string, KeyStats> meta_store;
+    Dict<KeyStats> meta_store;
+    size_t key_bytes = 0; // heap bytes of the keys held in meta_store
     constexpr static double ALPHA = 0.5;
     constexpr static double BETA  = 0.3;
     constexpr static double GAMMA = 0.2;
 
+    // Approximate eviction (same idea as Redis' maxmemory-samples): each call scores a
+    // few random keys and merges them into a small pool of the lowest scores seen so
+    // far, so picking a victim costs O(EVICTION_SAMPLES) however many keys there are.
+    constexpr static size_t EVICTION_SAMPLES = 5;
+    constexpr static size_t EVICTION_POOL_SIZE = 16;
+    struct EvictionCandidate {
+        std::string key;
+        double score;
+    };
+    std::vector<EvictionCandidate> eviction_pool; // sorted by ascending score; may hold deleted keys
+    std::mt19937_64 rng{std::random_device{}()};
+
+    // Recomputes s.score as of now.
+    void computeScore(KeyStats& s, std::chrono::steady_clock::time_point now) const;
+    // Stats for key, created with default values on first use.
+    KeyStats& statsFor(std::string_view key);
+    void addToEvictionPool(std::string_view key, double score);
+
     // Helper to get current time point
     std::chrono::steady_clock::time_point getCurrentTime() const {
         return std::chrono::steady_clock::now();
@@ -30,28 +52,46 @@ private:
 
 public:
     // Records an access for a given key, updates its stats and score.
-    void recordAccess(const std::string& key);
+    void recordAccess(std::string_view key);
 
     // Sets or updates the TTL for a key, updates its stats and score.
-    void setTTL(const std::string& key, double ttl_seconds);
+    void setTTL(std::string_view key, double ttl_seconds);
 
     // Explicitly updates the score for a key.
-    void updateScore(const std::string& key);
+    void updateScore(std::string_view key);
 
     // Calculates the current remaining TTL for a key based on initial TTL and set time.
-    double getTTLRemaining(const std::string& key) const;
+    double getTTLRemaining(std::string_view key) const;
 
-    // Identifies and returns the key with the lowest score for eviction.
+    // Returns a key with a low score for eviction (approximately the lowest, from
+    // random samples), or an empty string when no key is tracked.
     std::string evictCandidate();
 
     // Removes a key's stats from the cache (e.g., after actual eviction or deletion).
-    void removeKey(const std::string& key);
+    void removeKey(std::string_view key);
 
     // Checks if a key exists in the meta_store.
-    bool contains(const std::string& key) const;
+    bool contains(std::string_view key) const;
 
     // Gets the current score of a key.
-    double getScore(const std::string& key);
+    double getScore(std::string_view key);
+
+    // Removes a key's stats and returns them, e.g. to re-attach them under a new name.
+    std::optional<KeyStats> takeStats(std::string_view key);
+
+    // Stats for key as they are, or nullptr if it is not tracked (e.g. to persist them).
+    const KeyStats* peekStats(std::string_view key) const { return meta_store.find(key); }
+
+    // Installs stats for a key, replacing any it already has.
+    void restoreStats(std::string_view key, const KeyStats& stats);
+
+    // Bulk loading: sizes the table for n keys, then adds keys not tracked yet with
+    // prepared stats, scored as of now, without the per-key lookups of recordAccess.
+    void reserve(size_t n) { meta_store.reserve(n); }
+    void loadKey(std::string_view key, KeyStats stats, std::chrono::steady_clock::time_point now);
+
+    // Approximate heap bytes used by the metadata (counted towards maxmemory).
+    size_t memoryUsage() const { return meta_store.tableBytes() + key_bytes; }
 
     // Clears all key stats from the cache.
     void clear();
@@ -0,0 +1,113 @@
+#ifndef APPEND_ONLY_FILE_H
+#define APPEND_ONLY_FILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sys/types.h>
+
+class CommandArgs;
+class RedisCommandHandler;
+
+// When logged commands are fsynced to disk (appendfsync).
+enum class AofFsync {
+    ALWAYS,   // before the client gets its reply; concurrent writers share one fsync
+    EVERYSEC, // once per second by a background thread (default): at most ~1s lost on a crash
+    NO        // left to the kernel
+};
+
+// Append-only log of the write commands (appendonly.aof), replayed on startup.
+//
+// Write commands are appended to an in-memory buffer as they succeed. Once a worker
+// has executed a whole batch of pipelined commands it calls commit() before sending
+// the replies. commit() is a group commit: the first worker to arrive writes (and
+// under ALWAYS fsyncs) everything buffered so far, and workers arriving meanwhile
+// wait for it instead of issuing their own write.
+//
+// The log only grows, so it is periodically rewritten: a forked child writes the
+// shortest command sequence rebuilding its copy of the keyspace, commands executed
+// meanwhile are collected in a rewrite buffer, and the two are joined into a new file
+// that atomically replaces the old one.
+class AppendOnlyFile {
+public:
+    struct Stats {
+        bool enabled = false;
+        bool rewrite_in_progress = false;
+        bool last_write_ok = true;
+        bool last_rewrite_ok = true;
+        uint64_t current_size = 0;
+        uint64_t base_size = 0;              // size right after the last rewrite
+        long long last_rewrite_duration_ms = -1;
+    };
+
+    static AppendOnlyFile& getInstance();
+
+    // Executes every command logged in filename through handler. A command cut off by a
+    // crash mid-write is truncated away with a warning; any other damage fails the load.
+    // Must run before open(), so replayed commands are not logged again.
+    static bool replay(const std::string& filename, RedisCommandHandler& handler);
+
+    // Opens filename for appending (creating it if needed) and starts logging.
+    bool open(const std::string& filename, AofFsync policy);
+    bool isEnabled() const { return enabled.load(std::memory_order_acquire); }
+    // Writes and fsyncs everything still buffered, stops a running rewrite and closes the log.
+    void shutdown();
+
+    // Held shared by a write command from before it executes until it is appended, so a
+    // rewrite never forks between a change to the keyspace and its log entry.
+    std::shared_lock<std::shared_mutex> writeGate() { return std::shared_lock<std::shared_mutex>(gate); }
+    void append(const CommandArgs& args);
+    void append(const std::vector<std::string_view>& args);
+    // Makes this thread's appended commands durable per the fsync policy. Returns false
+    // if writing the log failed.
+    bool commit();
+
+    // Starts a background rewrite; false if disabled, already rewriting, or fork failed.
+    bool rewriteInBackground();
+
+    void setFsyncPolicy(AofFsync p) { policy.store(p); }
+    const char* getFsyncPolicy() const;
+    static bool parseFsyncPolicy(std::string_view name, AofFsync& p);
+    Stats stats();
+
+private:
+    AppendOnlyFile() = default;
+    AppendOnlyFile(const AppendOnlyFile&) = delete;
+    AppendOnlyFile& operator=(const AppendOnlyFile&) = delete;
+
+    // Rewrite automatically once the log is both this large and twice its post-rewrite size.
+    static constexpr uint64_t AUTO_REWRITE_MIN_SIZE = 64ULL * 1024 * 1024;
+
+    std::atomic<bool> enabled{false};
+    std::atomic<AofFsync> policy{AofFsync::EVERYSEC};
+    std::string filename;
+    std::shared_mutex gate;
+
+    std::mutex mutex;                // guards everything below
+    std::condition_variable committed; // signalled when a group commit finishes
+    std::string buffer;              // appended, not yet handed to write()
+    std::string batch;               // buffer being written by the current leader
+    uint64_t appended = 0;           // log offsets: end of everything appended ...
+    uint64_t written = 0;            // ... handed to the kernel ...
+    uint64_t synced = 0;             // ... and fsynced
+    bool leader_active = false;      // a commit is writing outside the mutex
+    Stats current;
+    pid_t rewrite_child = -1;
+    std::string rewrite_buffer;      // commands appended since the rewrite child forked
+
+    std::mutex io_mutex;             // serializes write()/fsync() on fd with swapping it
+    int fd = -1;
+
+    void appendEncoded(const std::string_view* args, size_t count);
+    void cronLoop();
+    void reapRewriteChild(pid_t pid, std::chrono::steady_clock::time_point started, const std::string& tmp);
+    bool installRewrite(const std::string& tmp); // caller holds mutex, no commit in flight
+};
+
+#endif // APPEND_ONLY_FILE_H
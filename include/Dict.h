@@ -0,0 +1,432 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <new>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Open-addressing hash table used for the keyspace and its per-key eviction metadata.
+//
+// Layout follows the SwissTable design: slots are grouped 16 at a time and every
+// slot has a one-byte control tag (empty, deleted, or 7 bits of the key's hash).
+// A lookup loads a whole group of tags and compares them against the key's tag in
+// one SSE2 instruction, so only slots whose tag matches are ever compared by key.
+// Entries live inline in one flat array instead of one heap node per key.
+//
+// Resizing never rehashes everything at once. Like Redis' dict, a second table is
+// allocated (larger when full, smaller when mostly empty) and every subsequent
+// operation migrates a few slots from the old table to the new one; lookups consult
+// both tables until the old one is drained. This bounds the work of any single
+// operation no matter how large the table is.
+template <typename V>
+class Dict {
+public:
+    struct Entry {
+        std::string key;
+        V value;
+    };
+
+    Dict() = default;
+    ~Dict() {
+        destroyTable(tables[0]);
+        destroyTable(tables[1]);
+    }
+    Dict(const Dict&) = delete;
+    Dict& operator=(const Dict&) = delete;
+    // Leaves other empty; lets a whole table be handed off in O(1) (FLUSHALL ASYNC).
+    Dict(Dict&& other) noexcept { swap(other); }
+
+    void swap(Dict& other) noexcept {
+        std::swap(tables, other.tables);
+        std::swap(rehashing, other.rehashing);
+        std::swap(rehash_pos, other.rehash_pos);
+    }
+
+    size_t size() const { return tables[0].size + tables[1].size; }
+    bool empty() const { return size() == 0; }
+    bool isRehashing() const { return rehashing; }
+    // Number of slots across both tables (each slot holds at most one entry).
+    size_t capacity() const { return tables[0].capacity + tables[1].capacity; }
+    // Bytes held by the slot and control arrays (entries' own heap data excluded).
+    size_t tableBytes() const { return capacity() * (sizeof(Entry) + 1); }
+
+    V* find(std::string_view key) {
+        if (empty()) return nullptr;
+        rehashStep();
+        return const_cast<V*>(static_cast<const Dict*>(this)->find(key));
+    }
+
+    // Lookup without migrating slots, for read-only traversals.
+    const V* find(std::string_view key) const {
+        if (empty()) return nullptr;
+        uint64_t h = hashKey(key);
+        for (int t = 0; t < (rehashing ? 2 : 1); ++t) {
+            size_t idx = findSlot(tables[t], key, h);
+            if (idx != NPOS) return &tables[t].slots[idx].value;
+        }
+        return nullptr;
+    }
+
+    // Inserts key -> value unless key is already present. Returns the stored value
+    // and whether an insertion happened (value is left untouched when it did not).
+    std::pair<V*, bool> emplace(std::string_view key, V&& value) {
+        rehashStep();
+        uint64_t h = hashKey(key);
+        for (int t = 0; t < (rehashing ? 2 : 1); ++t) {
+            size_t idx = findSlot(tables[t], key, h);
+            if (idx != NPOS) return {&tables[t].slots[idx].value, false};
+        }
+        Table& target = insertTable();
+        size_t idx = insertSlot(target, h);
+        new (&target.slots[idx]) Entry{std::string(key), std::move(value)};
+        return {&target.slots[idx].value, true};
+    }
+
+    bool erase(std::string_view key) {
+        if (empty()) return false;
+        rehashStep();
+        uint64_t h = hashKey(key);
+        for (int t = 0; t < (rehashing ? 2 : 1); ++t) {
+            size_t idx = findSlot(tables[t], key, h);
+            if (idx != NPOS) {
+                eraseSlot(tables[t], idx);
+                maybeShrink();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Removes key and hands its value to the caller (e.g. to relink it under another key).
+    std::optional<V> take(std::string_view key) {
+        if (empty()) return std::nullopt;
+        rehashStep();
+        uint64_t h = hashKey(key);
+        for (int t = 0; t < (rehashing ? 2 : 1); ++t) {
+            size_t idx = findSlot(tables[t], key, h);
+            if (idx != NPOS) {
+                std::optional<V> out(std::move(tables[t].slots[idx].value));
+                eraseSlot(tables[t], idx);
+                maybeShrink();
+                return out;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Sizes an empty table for n keys up front, so a bulk load never rehashes.
+    void reserve(size_t n) {
+        if (!empty() || n == 0) return;
+        size_t cap = GROUP_WIDTH;
+        while (cap - cap / 8 < n) {
+            if (cap > SIZE_MAX / 2) return; // no table that large: let inserts grow it
+            cap *= 2;
+        }
+        clear();
+        allocateTable(tables[0], cap);
+    }
+
+    void clear() {
+        destroyTable(tables[0]);
+        destroyTable(tables[1]);
+        rehashing = false;
+        rehash_pos = 0;
+    }
+
+    // Visits every entry. The callback must not insert into or erase from the table.
+    template <typename F>
+    void forEach(F&& f) {
+        for (int t = 0; t < 2; ++t) {
+            Table& table = tables[t];
+            for (size_t i = 0; i < table.capacity; ++i) {
+                if (isFull(table.ctrl[i])) f(table.slots[i].key, table.slots[i].value);
+            }
+        }
+    }
+    template <typename F>
+    void forEach(F&& f) const {
+        for (int t = 0; t < 2; ++t) {
+            const Table& table = tables[t];
+            for (size_t i = 0; i < table.capacity; ++i) {
+                if (isFull(table.ctrl[i])) f(table.slots[i].key, table.slots[i].value);
+            }
+        }
+    }
+
+    // Cursor-based iteration (Redis' dictScan). Start with cursor 0 and pass each
+    // returned cursor to the next call until it returns 0 again. Each call visits the
+    // entries of one home group (the group a key's probe sequence starts from) and, while
+    // rehashing, of every group of the larger table that maps to it. The cursor counts
+    // home groups with its bits reversed, so growing or shrinking the table between calls
+    // neither skips groups nor revisits many: every entry present for the whole iteration
+    // is visited at least once, and some may be visited twice.
+    template <typename F>
+    uint64_t scan(uint64_t cursor, F&& f) const {
+        if (empty()) return 0;
+        if (!rehashing) {
+            uint64_t mask = groupMask(tables[0]);
+            scanHomeGroup(tables[0], cursor & mask, f);
+            return nextCursor(cursor, mask);
+        }
+        const Table* small = &tables[0];
+        const Table* large = &tables[1];
+        if (small->capacity > large->capacity) std::swap(small, large);
+        uint64_t m0 = groupMask(*small), m1 = groupMask(*large);
+        scanHomeGroup(*small, cursor & m0, f);
+        // The groups of the larger table whose low bits are the smaller table's group
+        do {
+            scanHomeGroup(*large, cursor & m1, f);
+            cursor = nextCursor(cursor, m1);
+        } while (cursor & (m0 ^ m1));
+        return cursor;
+    }
+
+    // Returns some entry chosen from the random number r (the first occupied slot at
+    // or after a random position), or nullptr when the table is empty.
+    Entry* sample(uint64_t r) {
+        if (empty()) return nullptr;
+        int t = (rehashing && tables[1].size > 0 && (tables[0].size == 0 || (r >> 32) % size() >= tables[0].size)) ? 1 : 0;
+        Table& table = tables[t];
+        size_t mask = table.capacity - 1;
+        size_t start = r & mask;
+        for (size_t i = 0; i < table.capacity; ++i) {
+            size_t idx = (start + i) & mask;
+            if (isFull(table.ctrl[idx])) return &table.slots[idx];
+        }
+        return nullptr;
+    }
+
+private:
+    static constexpr size_t GROUP_WIDTH = 16;
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+    static constexpr size_t REHASH_SLOTS_PER_STEP = 2 * GROUP_WIDTH;
+    // Control byte values. Full slots store the 7-bit tag (0..127), so the high bit
+    // alone tells empty/deleted apart from full.
+    static constexpr int8_t CTRL_EMPTY = -128;
+    static constexpr int8_t CTRL_DELETED = -2;
+
+    struct Table {
+        int8_t* ctrl = nullptr;
+        Entry* slots = nullptr;
+        size_t capacity = 0;    // power of two, multiple of GROUP_WIDTH (or 0)
+        size_t size = 0;
+        size_t growth_left = 0; // inserts into empty slots left before the max load (7/8)
+    };
+
+    Table tables[2];     // tables[1] is only in use while rehashing
+    bool rehashing = false;
+    size_t rehash_pos = 0; // next tables[0] slot to migrate
+
+    static bool isFull(int8_t c) { return c >= 0; }
+
+    static uint64_t hashKey(std::string_view key) {
+        // Mix the standard hash so that keys sharing low bits (e.g. all keys of one
+        // shard) still spread over groups and tags.
+        uint64_t h = std::hash<std::string_view>{}(key);
+        return h * 0x9E3779B97F4A7C15ULL;
+    }
+    static size_t groupOf(uint64_t h) { return static_cast<size_t>(h >> 7); }
+    static int8_t tagOf(uint64_t h) { return static_cast<int8_t>(h >> 57); }
+
+#if defined(__SSE2__)
+    static uint32_t matchTag(const int8_t* group, int8_t tag) {
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl)));
+    }
+    static uint32_t matchEmptyOrDeleted(const int8_t* group) {
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+    }
+#else
+    static uint32_t matchTag(const int8_t* group, int8_t tag) {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+            if (group[i] == tag) mask |= 1u << i;
+        }
+        return mask;
+    }
+    static uint32_t matchEmptyOrDeleted(const int8_t* group) {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+            if (group[i] < 0) mask |= 1u << i;
+        }
+        return mask;
+    }
+#endif
+    static uint32_t matchEmpty(const int8_t* group) { return matchTag(group, CTRL_EMPTY); }
+
+    static uint64_t groupMask(const Table& table) { return table.capacity / GROUP_WIDTH - 1; }
+
+    static uint64_t reverseBits(uint64_t v) {
+        v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+        v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+        v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        return __builtin_bswap64(v);
+    }
+    // Increments the cursor's masked bits from the most significant down.
+    static uint64_t nextCursor(uint64_t cursor, uint64_t mask) {
+        return reverseBits(reverseBits(cursor | ~mask) + 1);
+    }
+
+    // Visits the entries whose home group is home: they sit somewhere along its probe
+    // sequence, which findSlot() never follows past a group with an empty slot.
+    template <typename F>
+    static void scanHomeGroup(const Table& table, uint64_t home, F& f) {
+        size_t mask = groupMask(table);
+        size_t g = home;
+        for (size_t i = 0; i <= mask; ++i) {
+            const int8_t* group = table.ctrl + g * GROUP_WIDTH;
+            for (uint32_t m = ~matchEmptyOrDeleted(group) & 0xFFFF; m != 0; m &= m - 1) {
+                const Entry& e = table.slots[g * GROUP_WIDTH + __builtin_ctz(m)];
+                if ((groupOf(hashKey(e.key)) & mask) == home) f(e.key, e.value);
+            }
+            if (matchEmpty(group)) return;
+            g = (g + i + 1) & mask;
+        }
+    }
+
+    static size_t findSlot(const Table& table, std::string_view key, uint64_t h) {
+        if (table.capacity == 0) return NPOS;
+        size_t groupMask = table.capacity / GROUP_WIDTH - 1;
+        size_t g = groupOf(h) & groupMask;
+        int8_t tag = tagOf(h);
+        // Triangular probing over groups visits every group once for power-of-two sizes.
+        for (size_t i = 0; i <= groupMask; ++i) {
+            const int8_t* group = table.ctrl + g * GROUP_WIDTH;
+            for (uint32_t m = matchTag(group, tag); m != 0; m &= m - 1) {
+                size_t idx = g * GROUP_WIDTH + __builtin_ctz(m);
+                if (table.slots[idx].key == key) return idx;
+            }
+            if (matchEmpty(group)) return NPOS; // The key would have been placed here
+            g = (g + i + 1) & groupMask;
+        }
+        return NPOS;
+    }
+
+    // Claims a slot for a key known to be absent from the table.
+    static size_t insertSlot(Table& table, uint64_t h) {
+        size_t groupMask = table.capacity / GROUP_WIDTH - 1;
+        size_t g = groupOf(h) & groupMask;
+        for (size_t i = 0; ; ++i) {
+            int8_t* group = table.ctrl + g * GROUP_WIDTH;
+            uint32_t m = matchEmptyOrDeleted(group);
+            if (m != 0) {
+                size_t idx = g * GROUP_WIDTH + __builtin_ctz(m);
+                if (table.ctrl[idx] == CTRL_EMPTY) table.growth_left--;
+                table.ctrl[idx] = tagOf(h);
+                table.size++;
+                return idx;
+            }
+            g = (g + i + 1) & groupMask;
+        }
+    }
+
+    static void eraseSlot(Table& table, size_t idx) {
+        table.slots[idx].~Entry();
+        const int8_t* group = table.ctrl + (idx & ~(GROUP_WIDTH - 1));
+        // A group that still has an empty slot has never been full, so no probe
+        // sequence continues past it and the slot can go straight back to empty.
+        if (matchEmpty(group)) {
+            table.ctrl[idx] = CTRL_EMPTY;
+            table.growth_left++;
+        } else {
+            table.ctrl[idx] = CTRL_DELETED;
+        }
+        table.size--;
+    }
+
+    static void allocateTable(Table& table, size_t capacity) {
+        table.ctrl = new int8_t[capacity];
+        std::memset(table.ctrl, CTRL_EMPTY, capacity);
+        table.slots = static_cast<Entry*>(::operator new(capacity * sizeof(Entry)));
+        table.capacity = capacity;
+        table.size = 0;
+        table.growth_left = capacity - capacity / 8;
+    }
+
+    static void destroyTable(Table& table) {
+        for (size_t i = 0; i < table.capacity; ++i) {
+            if (isFull(table.ctrl[i])) table.slots[i].~Entry();
+        }
+        delete[] table.ctrl;
+        ::operator delete(table.slots);
+        table = Table();
+    }
+
+    // Table that receives new keys, starting a rehash first if it is out of room.
+    Table& insertTable() {
+        if (tables[0].capacity == 0) {
+            allocateTable(tables[0], GROUP_WIDTH);
+            return tables[0];
+        }
+        Table& target = rehashing ? tables[1] : tables[0];
+        if (target.growth_left > 0) return target;
+
+        if (rehashing) {
+            // Still migrating but the new table filled up: finish the migration first.
+            while (rehashing) rehashStep();
+        }
+        // Double when genuinely full; otherwise the table is mostly tombstones and
+        // rebuilding it at the same size is enough.
+        size_t cap = tables[0].capacity;
+        size_t newCap = tables[0].size >= cap * 7 / 16 ? cap * 2 : cap;
+        allocateTable(tables[1], newCap);
+        rehashing = true;
+        rehash_pos = 0;
+        return tables[1];
+    }
+
+    // Starts migrating into a smaller table once the table is less than 10% full (as
+    // Redis does), so memory freed by deletes and evictions is actually returned.
+    void maybeShrink() {
+        if (empty()) {
+            clear(); // also ends a rehash that no later operation would finish
+            return;
+        }
+        if (rehashing) return;
+        size_t cap = tables[0].capacity;
+        if (cap <= GROUP_WIDTH || tables[0].size * 10 >= cap) return;
+        size_t newCap = GROUP_WIDTH;
+        while (newCap < tables[0].size * 2) newCap *= 2; // lands at most half full
+        allocateTable(tables[1], newCap);
+        rehashing = true;
+        rehash_pos = 0;
+    }
+
+    // Migrates a bounded number of slots from the old table into the new one.
+    void rehashStep() {
+        if (!rehashing) return;
+        Table& from = tables[0];
+        Table& to = tables[1];
+        size_t end = std::min(from.capacity, rehash_pos + REHASH_SLOTS_PER_STEP);
+        for (; rehash_pos < end; ++rehash_pos) {
+            if (!isFull(from.ctrl[rehash_pos])) continue;
+            Entry& e = from.slots[rehash_pos];
+            size_t idx = insertSlot(to, hashKey(e.key));
+            new (&to.slots[idx]) Entry(std::move(e));
+            e.~Entry();
+            // Keep probe chains of not-yet-migrated keys intact.
+            from.ctrl[rehash_pos] = CTRL_DELETED;
+            from.size--;
+        }
+        if (rehash_pos >= from.capacity) {
+            destroyTable(from);
+            tables[0] = to;
+            tables[1] = Table();
+            rehashing = false;
+            rehash_pos = 0;
+        }
+    }
+};
+
+#endif // DICT_H
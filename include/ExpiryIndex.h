@@ -0,0 +1,89 @@
+#ifndef EXPIRY_INDEX_H
+#define EXPIRY_INDEX_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include "RedisObject.h" // mallocSize, stringHeapBytes
+
+// Deadline-ordered index of the keys that carry a TTL: a binary min-heap of
+// (deadline, key), so the next key to expire is always at the front.
+//
+// Entries are never updated in place. Changing or removing a key's TTL simply
+// leaves its old entry behind; whoever pops an entry checks it against the key's
+// current deadline and skips it if they differ. Stale entries are purged in bulk
+// once they make up half the heap, which keeps that cleanup amortized O(1) per add.
+class ExpiryIndex {
+public:
+    struct Entry {
+        long long deadline_ms;
+        std::string key;
+    };
+
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+
+    // isCurrent(entry) must tell whether entry still matches its key's deadline; it is
+    // used to drop stale entries when the heap has grown to twice its last live size.
+    template <typename IsCurrent>
+    void add(long long deadline_ms, std::string_view key, IsCurrent&& isCurrent) {
+        if (heap.size() >= 2 * live_floor) {
+            compact(isCurrent);
+        }
+        key_bytes += stringHeapBytes(key.size());
+        heap.push_back(Entry{deadline_ms, std::string(key)});
+        std::push_heap(heap.begin(), heap.end(), later);
+    }
+
+    // Deadline of the earliest entry; only valid when !empty().
+    long long nextDeadline() const { return heap.front().deadline_ms; }
+
+    // Removes and returns the earliest entry; only valid when !empty().
+    Entry pop() {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        Entry e = std::move(heap.back());
+        heap.pop_back();
+        key_bytes -= stringHeapBytes(e.key.size());
+        if (heap.capacity() > MIN_COMPACT_SIZE && heap.size() < heap.capacity() / 4) {
+            heap.shrink_to_fit(); // give memory back once a burst of TTLs has drained
+        }
+        return e;
+    }
+
+    // Approximate heap bytes, counted towards maxmemory.
+    size_t memoryUsage() const { return mallocSize(heap.capacity() * sizeof(Entry)) + key_bytes; }
+
+    void clear() {
+        std::vector<Entry>().swap(heap);
+        key_bytes = 0;
+        live_floor = MIN_COMPACT_SIZE;
+    }
+
+private:
+    static constexpr size_t MIN_COMPACT_SIZE = 64;
+
+    std::vector<Entry> heap;
+    size_t key_bytes = 0;                   // heap bytes of the key copies
+    size_t live_floor = MIN_COMPACT_SIZE;   // live entries after the last compaction
+
+    static bool later(const Entry& a, const Entry& b) { return a.deadline_ms > b.deadline_ms; }
+
+    template <typename IsCurrent>
+    void compact(IsCurrent& isCurrent) {
+        auto end = std::remove_if(heap.begin(), heap.end(), [&](const Entry& e) {
+            if (isCurrent(e)) return false;
+            key_bytes -= stringHeapBytes(e.key.size());
+            return true;
+        });
+        heap.erase(end, heap.end());
+        std::make_heap(heap.begin(), heap.end(), later);
+        if (heap.capacity() > 2 * heap.size() + MIN_COMPACT_SIZE) {
+            heap.shrink_to_fit();
+        }
+        live_floor = std::max(heap.size(), MIN_COMPACT_SIZE);
+    }
+};
+
+#endif // EXPIRY_INDEX_H
@@ -0,0 +1,67 @@
+#ifndef INTSET_H
+#define INTSET_H
+
+#include <vector>
+#include <variant>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Compact encoding of a set whose members all read as 64-bit integers (Redis' intset):
+// the values kept sorted in one packed array, 4 bytes each while every value fits in
+// 32 bits and 8 bytes from the first one that does not. Membership is a binary
+// search, and set algebra between intsets is a merge of sorted arrays (see the
+// kernels below). Callers switch to a hash set once the set outgrows
+// set-max-intset-entries or gains a member that is not an integer.
+class Intset {
+public:
+    size_t size() const {
+        return std::visit([](const auto& v) { return v.size(); }, values);
+    }
+    bool wide() const { return values.index() == 1; } // 64-bit values
+
+    bool contains(int64_t v) const;
+    // Returns true if v was added; widens the array first if v needs 64 bits.
+    bool insert(int64_t v);
+    bool erase(int64_t v);
+    // Replaces the contents with sorted, duplicate-free values.
+    void assignSorted(const std::vector<int64_t>& sorted);
+
+    // Calls fn(int64_t) for every value, in ascending order.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        std::visit([&fn](const auto& v) {
+            for (auto x : v) fn(static_cast<int64_t>(x));
+        }, values);
+    }
+    // The values as an array of T (int32_t only while !wide()). A narrow set read as
+    // int64_t is widened into scratch, which then backs the returned pointer.
+    template <typename T>
+    const T* data(std::vector<T>& scratch) const {
+        if (const auto* v = std::get_if<std::vector<T>>(&values)) return v->data();
+        scratch.clear();
+        forEach([&scratch](int64_t x) { scratch.push_back(static_cast<T>(x)); });
+        return scratch.data();
+    }
+
+    // Heap bytes of the array.
+    size_t memoryUsage() const;
+
+private:
+    std::variant<std::vector<int32_t>, std::vector<int64_t>> values;
+};
+
+// Set algebra kernels over sorted, duplicate-free arrays. Each writes its result,
+// sorted as well, to out and returns its length; out must have room for na values
+// (intersection, difference) or na + nb (union). With SSE2, intersection and
+// difference compare a block of a against a block of b in a handful of
+// instructions (every lane against every rotation of the other block) instead of
+// one branchy comparison per pair, so runs of non-matching values cost little.
+size_t intersectSorted(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out);
+size_t intersectSorted(const int64_t* a, size_t na, const int64_t* b, size_t nb, int64_t* out);
+size_t differenceSorted(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out); // a - b
+size_t differenceSorted(const int64_t* a, size_t na, const int64_t* b, size_t nb, int64_t* out);
+size_t unionSorted(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out);
+size_t unionSorted(const int64_t* a, size_t na, const int64_t* b, size_t nb, int64_t* out);
+
+#endif // INTSET_H
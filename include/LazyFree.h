@@ -0,0 +1,61 @@
+#ifndef LAZY_FREE_H
+#define LAZY_FREE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+// Background reclamation of large values (Redis' lazyfree).
+//
+// Deleting a key unlinks it from its shard in O(1), but destroying a list or hash of
+// millions of elements visits every node, and would otherwise happen with the shard
+// lock held, stalling every client of that shard. Such values are moved in here
+// instead and destroyed by a background thread once the lock has been released.
+class LazyFree {
+public:
+    static LazyFree& getInstance();
+
+    // Values whose freeEffort() (see RedisObject) is at most this are destroyed inline:
+    // handing them over would cost more than freeing them. Redis uses the same limit.
+    static constexpr size_t THRESHOLD = 64;
+
+    // Takes ownership of value and destroys it on the background thread.
+    template <typename T>
+    void reclaim(T&& value) {
+        enqueue(std::make_unique<Holder<std::decay_t<T>>>(std::forward<T>(value)));
+    }
+
+    uint64_t pendingObjects() const { return pending.load(std::memory_order_relaxed); }
+    uint64_t freedObjects() const { return freed.load(std::memory_order_relaxed); }
+
+private:
+    LazyFree();
+    LazyFree(const LazyFree&) = delete;
+    LazyFree& operator=(const LazyFree&) = delete;
+
+    struct Job {
+        virtual ~Job() = default;
+    };
+    template <typename T>
+    struct Holder : Job {
+        T value;
+        explicit Holder(T&& v) : value(std::move(v)) {}
+    };
+
+    void enqueue(std::unique_ptr<Job> job);
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::unique_ptr<Job>> jobs;
+    std::atomic<uint64_t> pending{0}; // queued, not destroyed yet
+    std::atomic<uint64_t> freed{0};   // destroyed by the background thread
+};
+
+#endif // LAZY_FREE_H
@@ -0,0 +1,59 @@
+#ifndef LISTPACK_H
+#define LISTPACK_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Compact encoding of a small hash or sorted set: its field/value pairs (member/score
+// for a sorted set) packed one after the other in a single buffer, each string stored as
+//
+//   <length:varint> <bytes>
+//
+// Lookups scan the buffer from the start. For the few dozen short fields it is meant
+// for, that costs less than hashing, and the whole hash is one allocation instead of
+// a bucket array plus a node and two strings per field. Callers switch to a real hash
+// table (or skiplist) once the value outgrows the configured limits.
+class Listpack {
+public:
+    size_t size() const { return count; } // field/value pairs
+
+    // Sets value to the value of field; false if field is absent. The view is valid
+    // until the listpack is next modified.
+    bool find(std::string_view field, std::string_view& value) const;
+    // Sets field to value. Returns true if field was added, false if it was updated.
+    bool set(std::string_view field, std::string_view value);
+    // Appends a pair without looking for field; the caller knows it is absent.
+    void append(std::string_view field, std::string_view value);
+    // Inserts a pair so that it becomes pair number index (index <= size()), again
+    // without looking for field. Sorted sets use it to keep their pairs in order.
+    void insert(size_t index, std::string_view field, std::string_view value);
+    bool erase(std::string_view field);
+
+    // Calls fn(field, value) for every pair, in order.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        const char* p = buf.data();
+        for (uint32_t i = 0; i < count; ++i) {
+            std::string_view field = decode(p);
+            std::string_view value = decode(p);
+            fn(field, value);
+        }
+    }
+
+    // Heap bytes of the buffer.
+    size_t memoryUsage() const;
+
+private:
+    std::string buf;
+    uint32_t count = 0;
+
+    static void encode(std::string& out, std::string_view s);
+    // Decodes the string at p and advances p past it.
+    static std::string_view decode(const char*& p);
+    // Offset of the pair whose field is field, or npos.
+    size_t locate(std::string_view field) const;
+};
+
+#endif // LISTPACK_H
@@ -0,0 +1,110 @@
+#ifndef QUICKLIST_H
+#define QUICKLIST_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// List value: a doubly linked chain of nodes, each a contiguous block of up to
+// NODE_BYTES packed elements (the layout of Redis' quicklist of listpacks).
+//
+// An element is stored as
+//
+//   <length:varint> <bytes> <backlen>
+//
+// where backlen is the size of the first two parts, encoded so it can be decoded
+// from its last byte backwards. The first element of a block is found from the front
+// and the last one from the back, so pushing or popping at either end touches one
+// block of bounded size whatever the list's length. An element costs its bytes plus
+// 2-10 bytes, instead of a std::string and often a heap chunk of its own.
+//
+// Positional access walks the nodes from the nearer end by their element counts,
+// then the elements of one block.
+class Quicklist {
+public:
+    Quicklist() = default;
+    ~Quicklist() { clear(); }
+    Quicklist(const Quicklist& other);
+    Quicklist& operator=(const Quicklist& other);
+    Quicklist(Quicklist&& other) noexcept;
+    Quicklist& operator=(Quicklist&& other) noexcept;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void pushFront(std::string_view value);
+    void pushBack(std::string_view value);
+    // Remove the first/last element into value; false if the list is empty.
+    bool popFront(std::string& value);
+    bool popBack(std::string& value);
+
+    // The element at index (0 is the head); false if out of range. The view is valid
+    // until the list is next modified.
+    bool at(size_t index, std::string_view& value) const;
+    // Replaces the element at index; false if out of range.
+    bool set(size_t index, std::string_view value);
+    // Removes elements equal to value: the first limit of them from the head if limit is
+    // positive, the last -limit from the tail if negative, all if zero. Returns how many.
+    size_t removeMatching(std::string_view value, long long limit);
+
+    // Calls fn(std::string_view) for every element from head to tail.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const Node* n = head; n; n = n->next) {
+            const char* p = n->buf;
+            for (uint32_t i = 0; i < n->count; ++i) {
+                size_t entry_size;
+                std::string_view value = decodeForward(p, entry_size);
+                fn(value);
+                p += entry_size;
+            }
+        }
+    }
+
+    // Number of blocks: what destroying the list costs, in frees.
+    size_t nodeCount() const { return nodes; }
+
+    // Heap bytes of the nodes and their blocks; kept current, so O(1).
+    size_t memoryUsage() const { return bytes; }
+
+    void clear();
+
+private:
+    // Blocks stop accepting elements past this size (Redis' list-max-listpack-size -2).
+    // A larger element gets a node of its own.
+    static constexpr size_t NODE_BYTES = 8 * 1024;
+    static constexpr size_t MIN_BLOCK = 32;
+
+    struct Node {
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        char* buf = nullptr;
+        size_t used = 0;     // bytes of encoded elements at the start of buf
+        size_t capacity = 0; // allocated size of buf
+        uint32_t count = 0;  // elements in buf
+    };
+
+    Node* head = nullptr;
+    Node* tail = nullptr;
+    size_t count = 0;
+    size_t nodes = 0;
+    size_t bytes = 0;
+
+    static size_t entrySize(size_t len);
+    static void encode(char* p, std::string_view value);
+    // Decodes the element starting at p; entry_size receives its encoded size.
+    static std::string_view decodeForward(const char* p, size_t& entry_size);
+    // Decodes the element ending at end.
+    static std::string_view decodeBackward(const char* end, size_t& entry_size);
+
+    Node* insertNode(Node* after); // after == nullptr inserts at the head
+    void removeNode(Node* n);
+    void reserve(Node* n, size_t needed);
+    // The node holding element index, and the index within it.
+    Node* locate(size_t index, size_t& offset) const;
+    // Start of the offset-th element of n.
+    static char* entryAt(Node* n, size_t offset);
+};
+
+#endif // QUICKLIST_H
@@ -2,12 +2,42 @@
 #define REDIS_COMMAND_HANDLER_H
 
 #include<string>
+#include<string_view>
+
+class CommandArgs;
+class RedisDatabase;
+
+//Command flags
+enum RedisCommandFlags {
+    CMD_READONLY = 1 << 0, //never modifies the keyspace; safe to run alongside other readers
+    CMD_WRITE    = 1 << 1, //may modify the keyspace
+    CMD_DENYOOM  = 1 << 2, //may grow memory: evicts first, refused if maxmemory cannot be honoured
+    CMD_ADMIN    = 1 << 3  //server administration; touches no keys
+};
+
+//One entry of the static command table.
+struct RedisCommand {
+    const char* name;
+    //Redis convention: N means exactly N arguments (command name included), -N means at least N.
+    int arity;
+    int flags;
+    std::string (*handler)(const CommandArgs& tokens, RedisDatabase& db);
+
+    bool acceptsArgCount(size_t argc) const {
+        return arity >= 0 ? argc == static_cast<size_t>(arity) : argc >= static_cast<size_t>(-arity);
+    }
+};
 
 class RedisCommandHandler{
 public: 
     RedisCommandHandler();
+    //Case-insensitive O(1) lookup in the command table; nullptr for unknown commands.
+    static const RedisCommand* lookupCommand(std::string_view name);
+
     //Process a command from a client and return RESP-formatted response
     std::string processCommand(const std::string& commandLine);
+    //Execute one already parsed command (see RespParser) and return its RESP-formatted response
+    std::string processCommand(const CommandArgs& tokens);
 
 };
 #endif
\ No newline at end of file
@@ -2,56 +2,249 @@
 #define REDIS_DATABASE_H
 
 #include<string>
-#include<mutex>//thread safety if needed in future
+#include<string_view>
+#include<mutex>//per-shard locking
+#include<algorithm>
+#include<functional>
 #include<unordered_map>
 #include<vector>
+#include<optional>
 #include<chrono>
-#include "D:\\projects\\Enhanced-Redis\\include\\AdaptivePredictiveCache.h"
+#include<atomic>
+#include<random>
+#include<sys/types.h>
+#include "AdaptivePredictiveCache.h"
+#include "RedisObject.h"
+#include "Dict.h"
+#include "ExpiryIndex.h"
+
+// What to do when a write would push used memory past maxmemory.
+enum class MaxmemoryPolicy {
+    ALLKEYS_APC,    // evict the keys with the lowest Adaptive Predictive Cache score (default)
+    ALLKEYS_RANDOM, // evict random keys
+    NOEVICTION      // refuse commands that would grow memory
+};
+
+// Options for RedisDatabase::set(), mirroring SET's NX / XX / KEEPTTL.
+enum SetFlags {
+    SET_NX      = 1 << 0, // only set if the key does not exist
+    SET_XX      = 1 << 1, // only set if the key already exists
+    SET_KEEPTTL = 1 << 2  // keep the key's current TTL instead of clearing it
+};
+
+// Options for RedisDatabase::zadd() and zincrBy(), mirroring ZADD's NX / XX / GT / LT.
+enum ZaddFlags {
+    ZADD_NX = 1 << 0, // only add new members
+    ZADD_XX = 1 << 1, // only update existing members
+    ZADD_GT = 1 << 2, // only update a member when its score increases
+    ZADD_LT = 1 << 3  // only update a member when its score decreases
+};
+
+// Set algebra of SINTER / SUNION / SDIFF and their STORE forms.
+enum class SetOperation {
+    INTER,
+    UNION,
+    DIFF // members of the first set found in none of the others
+};
+
 class RedisDatabase {
 public:
     //Get the singleton instance 
     static RedisDatabase& getInstance();
 
     //Common commands
-    bool flushAll();
+    //async hands the old contents to the lazy-free thread (FLUSHALL ASYNC), so the
+    //shards are locked only long enough to swap in empty stores.
+    bool flushAll(bool async=false);
 
     //Key/value operations
-    void set(const std::string & key,const std::string& value, double ttl_seconds = 0);
-    bool get(const std::string& key,std::string& value);
-    std::vector<std::string>keys();
-
-    std::string type(const std::string& key);
-    bool del(const std::string&key);
-    bool expire(const std::string& key,int seconds);
-    void checkAndEvict(); // New method for cache eviction
-    bool rename(const std::string& oldkey,const std::string& newkey);
+    //Keys and values are passed as views (usually into a connection's read buffer);
+    //they are copied exactly once, when stored.
+    //Type-specific operations on a key holding another type throw WrongTypeError.
+    //expire_at_ms is an absolute deadline (see currentTimeMs()); 0 means no TTL.
+    //Returns false, changing nothing, when an SET_NX/SET_XX condition is not met.
+    bool set(std::string_view key,std::string_view value,long long expire_at_ms=0,int flags=0);
+    bool get(std::string_view key,std::string& value);
+    //Atomic string operations, each under a single shard lock. A missing key reads as an
+    //empty string (or 0) and is created; TTLs are kept. They throw CommandError when the
+    //stored value does not suit the operation, and WrongTypeError for a non-string key.
+    long long incrBy(std::string_view key,long long delta);
+    std::string incrByFloat(std::string_view key,long double delta); //returns the new value as stored
+    size_t append(std::string_view key,std::string_view value); //returns the new length
+    size_t setRange(std::string_view key,size_t offset,std::string_view value); //zero-pads a gap; returns the new length
+    std::string getRange(std::string_view key,long long start,long long end); //inclusive; negative counts from the end
+    size_t strLen(std::string_view key);
+    static constexpr size_t MAX_STRING_SIZE=512*1024*1024; //APPEND/SETRANGE limit, as in Redis
+    //Keys matching a glob pattern (see stringMatch). Shards are locked one at a time, and
+    //listing a key is not an access to it.
+    std::vector<std::string>keys(std::string_view pattern="*");
+    //Incremental iteration (SCAN). Start from cursor 0 and continue from each returned
+    //cursor until 0 comes back. A call visits about count keys' worth of the keyspace and
+    //adds the matching ones to keys; keys present for the whole iteration are returned at
+    //least once (possibly twice), whatever is written or resized in between. type, when
+    //given, keeps only keys of that type.
+    uint64_t scan(uint64_t cursor,size_t count,std::string_view pattern,std::optional<ObjectType> type,
+                  std::vector<std::string>& keys);
+    //HSCAN: the same over the fields of a hash. A listpack hash is returned whole, with cursor 0.
+    uint64_t hscan(std::string_view key,uint64_t cursor,size_t count,std::string_view pattern,
+                   std::vector<std::pair<std::string,std::string>>& fields);
+
+    std::string type(std::string_view key);
+    //Internal representation of key's value (OBJECT ENCODING); false if the key does not exist.
+    bool objectEncoding(std::string_view key,std::string& encoding);
+    //lazy (UNLINK) unlinks the key at once and leaves destroying a large value to the
+    //lazy-free thread (see LazyFree).
+    bool del(std::string_view key,bool lazy=false);
+    //Batch operations (MGET, MSET, MSETNX, DEL/EXISTS with several keys). Keys are grouped
+    //by shard and each shard is locked once per call instead of once per key.
+    std::vector<std::optional<std::string>>mget(const std::vector<std::string_view>& keys); //in key order; nullopt if missing or not a string
+    void mset(const std::vector<std::pair<std::string_view,std::string_view>>& keyValues);
+    //Sets every key only if none of them exists; holds all their shards for the whole check-and-set.
+    bool msetnx(const std::vector<std::pair<std::string_view,std::string_view>>& keyValues);
+    size_t del(const std::vector<std::string_view>& keys,bool lazy=false); //returns how many were deleted
+    //Whether DEL frees like UNLINK (lazyfree-lazy-user-del; off by default, as in Redis).
+    void setLazyfreeLazyUserDel(bool lazy){ lazyfree_lazy_user_del.store(lazy); }
+    bool getLazyfreeLazyUserDel() const { return lazyfree_lazy_user_del.load(); }
+    size_t exists(const std::vector<std::string_view>& keys); //a key named twice counts twice
+    //TTLs: deadlines are absolute wall-clock milliseconds; a deadline already past deletes the key.
+    bool expireAt(std::string_view key,long long deadline_ms); //false if the key does not exist
+    long long pttl(std::string_view key); //ms left; -1 without a TTL, -2 if the key does not exist
+    bool persist(std::string_view key);   //false if the key does not exist or has no TTL
+    // Evicts keys (per the maxmemory policy) until used memory is within maxmemory.
+    // Returns false if that is impossible, e.g. under NOEVICTION. Evicted key names are
+    // added to evicted when given (for the append-only file).
+    bool checkAndEvict(std::vector<std::string>* evicted=nullptr);
+    bool rename(std::string_view oldkey,std::string_view newkey);
+    // Active expiration: deletes keys whose TTL has passed, a small batch per shard at a
+    // time, and returns once none are due or after about time_budget_ms. Returns the count.
+    size_t activeExpireCycle(int time_budget_ms);
+    uint64_t expiredKeys() const; // deleted by TTL, lazily or actively
     //List operations
-    std::vector<std::string>lget(const std::string& key);
-    ssize_t llen(const std::string&key);
-    void lpush(const std::string& key,const std::string& value);
-    void rpush(const std::string& key,const std::string& value);
-    bool rpop(const std::string& key,std::string& value);
-    bool lpop(const std::string& key,std::string& value);
-    int lrem(const std::string& key,int count ,std::string& value);
-    bool lindex(const std::string& key,int index ,std::string& value);
-    bool lset(const std::string& key,int index ,const std::string& value);//update element in given position
+    std::vector<std::string>lget(std::string_view key);
+    ssize_t llen(std::string_view key);
+    void lpush(std::string_view key,std::string_view value);
+    void rpush(std::string_view key,std::string_view value);
+    bool rpop(std::string_view key,std::string& value);
+    bool lpop(std::string_view key,std::string& value);
+    int lrem(std::string_view key,int count ,std::string_view value);
+    bool lindex(std::string_view key,int index ,std::string& value);
+    bool lset(std::string_view key,int index ,std::string_view value);//update element in given position
 
     //Hash operations
-    bool hset(const std::string& key,const std::string &field,const std::string& value);
-    bool hget(const std::string& key,const std::string& field,std::string& value);
-    bool hexists(const std::string& key,const std::string& field);
-    bool hdel(const std::string& key,const std::string& field);
-    std::unordered_map<std::string,std::string>hgetall(const std::string&key);
-    std::vector<std::string>hkeys(const std::string& key);
-    std::vector<std::string>hvals(const std::string& key);
-    ssize_t hlen(const std::string& key);
-    bool hmset(const std::string& key,const std::vector<std::pair<std::string,std::string>>& fieldValues);
+    size_t hset(std::string_view key,const std::vector<std::pair<std::string_view,std::string_view>>& fieldValues); //returns how many fields were added
+    bool hget(std::string_view key,std::string_view field,std::string& value);
+    bool hexists(std::string_view key,std::string_view field);
+    size_t hdel(std::string_view key,const std::vector<std::string_view>& fields); //returns how many were removed
+    std::vector<std::pair<std::string,std::string>>hgetall(std::string_view key);
+    std::vector<std::string>hkeys(std::string_view key);
+    std::vector<std::string>hvals(std::string_view key);
+    ssize_t hlen(std::string_view key);
+    bool hmset(std::string_view key,const std::vector<std::pair<std::string_view,std::string_view>>& fieldValues);
+    //Hashes stay in the compact listpack encoding while they have at most entries fields
+    //and no field or value longer than value bytes (hash-max-listpack-entries/-value).
+    //Past either limit a hash is converted to a hash table for good.
+    void setHashMaxListpackEntries(size_t entries){ hash_max_listpack_entries.store(entries); }
+    void setHashMaxListpackValue(size_t bytes){ hash_max_listpack_value.store(bytes); }
+    size_t getHashMaxListpackEntries() const { return hash_max_listpack_entries.load(); }
+    size_t getHashMaxListpackValue() const { return hash_max_listpack_value.load(); }
+    struct ListpackLimits {
+        size_t entries;
+        size_t value;
+        bool fits(std::string_view field, std::string_view val) const {
+            return field.size() <= value && val.size() <= value;
+        }
+    };
+    ListpackLimits hashLimits() const { return {hash_max_listpack_entries.load(), hash_max_listpack_value.load()}; }
 
+    //Sorted set operations
+    //Adds or updates each (score, member) under flags; returns how many members were
+    //added, and sets updated to how many existing ones changed score (for CH).
+    size_t zadd(std::string_view key,const std::vector<std::pair<double,std::string_view>>& members,int flags,size_t& updated);
+    //ZINCRBY / ZADD INCR: adds delta to member's score (0 if absent) and sets score to the
+    //result. Returns false, changing nothing, when a flag condition is not met. Throws
+    //CommandError if the result is not a number (inf + -inf).
+    bool zincrBy(std::string_view key,std::string_view member,double delta,int flags,double& score);
+    bool zscore(std::string_view key,std::string_view member,double& score);
+    size_t zrem(std::string_view key,const std::vector<std::string_view>& members);
+    size_t zcard(std::string_view key);
+    //Rank counted from the lowest score, or from the highest if reverse; false if absent.
+    bool zrank(std::string_view key,std::string_view member,bool reverse,size_t& rank);
+    //Members with ranks start..stop, inclusive; negative ranks count from the end.
+    std::vector<std::pair<std::string,double>>zrange(std::string_view key,long long start,long long stop,bool reverse);
+    //Members with scores in range, lowest first (highest first if reverse), skipping
+    //offset of them and returning at most count (count < 0: no limit).
+    std::vector<std::pair<std::string,double>>zrangeByScore(std::string_view key,const ScoreRange& range,bool reverse,
+                                                            long long offset,long long count);
+    size_t zcount(std::string_view key,const ScoreRange& range);
+    //Sorted sets stay listpacks while they have at most entries members and none longer
+    //than value bytes (zset-max-listpack-entries/-value), then become skiplists for good.
+    void setZsetMaxListpackEntries(size_t entries){ zset_max_listpack_entries.store(entries); }
+    void setZsetMaxListpackValue(size_t bytes){ zset_max_listpack_value.store(bytes); }
+    size_t getZsetMaxListpackEntries() const { return zset_max_listpack_entries.load(); }
+    size_t getZsetMaxListpackValue() const { return zset_max_listpack_value.load(); }
+    ListpackLimits zsetLimits() const { return {zset_max_listpack_entries.load(), zset_max_listpack_value.load()}; }
 
+    //Set operations
+    size_t sadd(std::string_view key,const std::vector<std::string_view>& members); //returns how many were added
+    size_t srem(std::string_view key,const std::vector<std::string_view>& members); //returns how many were removed
+    bool sismember(std::string_view key,std::string_view member);
+    std::vector<bool>smismember(std::string_view key,const std::vector<std::string_view>& members);
+    size_t scard(std::string_view key);
+    std::vector<std::string>smembers(std::string_view key);
+    //SSCAN: like hscan(); an intset is returned whole, with cursor 0.
+    uint64_t sscan(std::string_view key,uint64_t cursor,size_t count,std::string_view pattern,
+                   std::vector<std::string>& members);
+    //Set algebra over keys in any shards, which are all held for the whole computation;
+    //a missing key is an empty set. When every input is an intset the sorted arrays are
+    //merged by vectorized kernels, otherwise the smallest set's members are probed in the
+    //others. Intersections start from the smallest sets either way.
+    std::vector<std::string>setOperation(SetOperation op,const std::vector<std::string_view>& keys);
+    //Stores the result at destination, replacing whatever it held (deleting it if the
+    //result is empty), and returns its size.
+    size_t setOperationStore(SetOperation op,std::string_view destination,const std::vector<std::string_view>& keys);
+    //SINTERCARD: size of the intersection, without replying with it; collecting stops at
+    //limit members (0: no limit).
+    size_t sinterCard(const std::vector<std::string_view>& keys,size_t limit);
+    //Sets stay intsets while they hold only integers and at most this many of them
+    //(set-max-intset-entries), then become hash sets for good.
+    void setSetMaxIntsetEntries(size_t entries){ set_max_intset_entries.store(entries); }
+    size_t getSetMaxIntsetEntries() const { return set_max_intset_entries.load(); }
+
+    //Memory accounting and limits
+    //Approximate bytes used by keys, values, tables and eviction metadata.
+    size_t usedMemory() const;
+    //Bytes attributable to one key (MEMORY USAGE); false if the key does not exist.
+    bool memoryUsage(std::string_view key,size_t& bytes);
+    void setMaxmemory(size_t bytes){ maxmemory.store(bytes); } //0 disables the limit
+    size_t getMaxmemory() const { return maxmemory.load(); }
+    bool setMaxmemoryPolicy(std::string_view name); //false for an unknown policy name
+    const char* getMaxmemoryPolicy() const;
+    uint64_t evictedKeys() const { return evicted_keys.load(); }
+    //Parses a size such as "1048576", "100mb" or "2gb" (k/m/g are powers of 1000, kb/mb/gb of 1024).
+    static bool parseMemorySize(std::string_view text,size_t& bytes);
 
     //Persistent: Dump /load the database from a file.
+    //dump() blocks every shard until the file is written (SAVE, shutdown); bgsave() forks a
+    //copy-on-write child to write it, so commands stall only for the fork itself.
     bool dump(const std::string& filename);
+    bool bgsave(const std::string& filename); //false if a save is already running or fork fails
     bool load(const std::string& filename);
+    //Outcome of the most recent save, foreground or background (INFO persistence).
+    struct SaveStats {
+        bool in_progress = false;
+        bool last_ok = true;
+        long long last_save_time = 0;   //unix seconds when it finished; 0 = never
+        long long last_duration_ms = 0;
+        uint64_t last_bytes = 0;
+        long long last_fork_us = 0;     //time commands were stalled by the last fork
+    };
+    SaveStats saveStats();
+    //Forks a child holding a point-in-time copy of the keyspace (every shard is locked
+    //across the fork) and runs child_main in it; the child exits 0 if it returns true.
+    //Returns the child's pid, or -1 if fork failed.
+    pid_t forkSnapshotChild(const std::function<bool()>& child_main);
+    //Visits every live key without locking: only for use inside forkSnapshotChild's child.
+    void forEachUnlocked(const std::function<void(const std::string&,const RedisObject&)>& fn);
 
     
 
@@ -60,14 +253,137 @@ private:
     ~RedisDatabase()=default;
     RedisDatabase(const RedisDatabase&)=delete;
     RedisDatabase& operator=(const RedisDatabase&) =delete;
-    
-    std::mutex db_mutex;
-    std::unordered_map<std::string,std::string> kv_store;
-    std::unordered_map<std::string,std::vector<std::string>> list_store;
-    std::unordered_map<std::string,std::unordered_map<std::string,std::string>> hash_store;//hash of key-value pairs
 
-    AdaptivePredictiveCache predictive_cache; // The new predictive cache
-    size_t max_cache_size = 10000; // Example max size for eviction trigger
+    // The keyspace is split into independently locked shards chosen by key hash, so
+    // commands on different keys rarely contend. Each shard owns its own stores and
+    // eviction metadata. Operations spanning several shards (RENAME, KEYS, FLUSHALL,
+    // DUMP) always lock shards in ascending index order to rule out deadlocks.
+    struct Shard {
+        std::mutex mutex;
+        Dict<RedisObject> keyspace; // key -> typed value (string/list/hash/zset/set); rehashes incrementally
+        AdaptivePredictiveCache predictive_cache; // Per-shard predictive cache
+        size_t data_bytes = 0;     // heap bytes of stored keys and values, kept up to date by every write
+        size_t reported_bytes = 0; // this shard's share of RedisDatabase::used_memory
+        ExpiryIndex expires;       // keys with a TTL, ordered by deadline
+        std::atomic<uint64_t> expired_keys{0};
+        std::mt19937_64 rng{std::random_device{}()};
+
+        // Internal helpers; callers must already hold mutex.
+        size_t getTotalKeyCount() const { return keyspace.size(); }
+        size_t usedMemory() const {
+            return data_bytes + keyspace.tableBytes() + predictive_cache.memoryUsage() + expires.memoryUsage();
+        }
+        // Heap bytes of one keyspace entry (the stored key copy plus the value).
+        static size_t entryBytes(std::string_view key, const RedisObject& obj) {
+            return stringHeapBytes(key.size()) + obj.memoryUsage();
+        }
+        RedisObject& insert(std::string_view key, RedisObject&& obj); // key must be absent
+        // lazy passes a large value to LazyFree rather than destroying it under the lock.
+        // Deletions the server makes on its own (expiry, eviction, overwrites) are lazy.
+        bool delInternal(std::string_view key, bool lazy = false);
+        // Returns the live object for key, or nullptr. An expired key is removed on the spot.
+        RedisObject* lookup(std::string_view key);
+        // Like lookup(), but throws WrongTypeError if the key holds another type.
+        RedisObject* lookupTyped(std::string_view key, ObjectType type);
+        // Returns the object for key, creating an empty one of the given type if missing.
+        RedisObject& lookupOrCreate(std::string_view key, ObjectType type);
+        // SET: stores value under key as a string, replacing any type (see RedisDatabase::set).
+        bool setString(std::string_view key, std::string_view value, long long expire_at_ms, int flags);
+        // Gives obj (stored under key) an absolute deadline and indexes it for active expiry.
+        void setExpire(std::string_view key, RedisObject& obj, long long deadline_ms);
+        // Deletes keys whose deadline is at or before now_ms, examining at most max_entries
+        // index entries. Sets more when due keys remain. Returns how many keys were deleted.
+        size_t expireDueKeys(long long now_ms, size_t max_entries, bool& more);
+        // Adds a key decoded from a snapshot together with its eviction metadata.
+        void restore(std::string_view key, RedisObject&& obj, long long expire_at_ms,
+                     const KeyStats& stats, std::chrono::steady_clock::time_point now);
+        // Sets field in a hash object, keeping data_bytes current. Converts a listpack
+        // that would outgrow limits to a hash table first. Returns true if field was added.
+        bool hashSet(RedisObject& obj, std::string_view field, std::string_view value, const ListpackLimits& limits);
+        // Sets member's score in a sorted set object, keeping data_bytes current and the
+        // listpack in order. Converts a listpack that would outgrow limits to a skiplist.
+        void zsetSet(RedisObject& obj, std::string_view member, double score, const ListpackLimits& limits);
+        bool zsetErase(RedisObject& obj, std::string_view member);
+        // Adds member to a set object, keeping data_bytes current. Converts an intset to
+        // a hash set first if member is not an integer or the intset is full.
+        bool setAdd(RedisObject& obj, std::string_view member, size_t max_intset_entries);
+        bool setRemove(RedisObject& obj, std::string_view member);
+        // Picks a key to evict under policy; empty if the shard has none.
+        std::string evictionCandidate(MaxmemoryPolicy policy);
+        void clear(bool lazy = false);
+    };
+
+    // Locks one shard for an operation. On release it publishes the shard's memory
+    // change to used_memory, so every write is reflected in the global total.
+    class ShardGuard {
+    public:
+        ShardGuard(RedisDatabase& db, Shard& shard) : db(db), shard(shard), lock(shard.mutex) {}
+        ~ShardGuard() { db.publishMemory(shard); }
+    private:
+        RedisDatabase& db;
+        Shard& shard;
+        std::lock_guard<std::mutex> lock;
+    };
+
+    // ShardGuard for the shards at indices (any order, repeats allowed), locked in
+    // ascending order as multi-shard operations require.
+    class MultiShardGuard {
+    public:
+        MultiShardGuard(RedisDatabase& db, std::vector<size_t> indices);
+        ~MultiShardGuard() {
+            for (size_t index : indices) db.publishMemory(db.shards[index]);
+        }
+    private:
+        RedisDatabase& db;
+        std::vector<size_t> indices;
+        std::vector<std::unique_lock<std::mutex>> locks;
+    };
+
+    static constexpr size_t SHARD_COUNT = 64; // power of two
+    static constexpr int SHARD_BITS = 6;      // log2(SHARD_COUNT): SCAN keeps the shard in the cursor's low bits
+    static constexpr size_t ACTIVE_EXPIRE_BATCH = 20; // index entries per shard per lock hold (as in Redis)
+    Shard shards[SHARD_COUNT];
+
+    std::atomic<long long> used_memory{0};  // sum of the shards' reported_bytes
+    std::atomic<size_t> maxmemory{0};       // 0 = no limit (Redis default)
+    std::atomic<MaxmemoryPolicy> maxmemory_policy{MaxmemoryPolicy::ALLKEYS_APC};
+    std::atomic<uint64_t> evicted_keys{0};
+    std::atomic<size_t> eviction_cursor{0}; // next shard to evict from (round-robin)
+    std::atomic<size_t> hash_max_listpack_entries{128};
+    std::atomic<size_t> hash_max_listpack_value{64};
+    std::atomic<size_t> zset_max_listpack_entries{128};
+    std::atomic<size_t> zset_max_listpack_value{64};
+    std::atomic<size_t> set_max_intset_entries{512};
+    std::atomic<bool> lazyfree_lazy_user_del{false};
+
+    std::mutex save_mutex;    // guards save_stats and save_child
+    SaveStats save_stats;
+    pid_t save_child = -1;    // running background save, or -1
+
+    size_t shardIndex(std::string_view key) const {
+        return std::hash<std::string_view>{}(key) & (SHARD_COUNT - 1);
+    }
+    Shard& shardFor(std::string_view key) { return shards[shardIndex(key)]; }
+    // Folds the shard's current usage into used_memory; caller holds the shard's mutex.
+    void publishMemory(Shard& shard);
+    // Locks every shard in index order; released when the returned locks go out of scope.
+    std::vector<std::unique_lock<std::mutex>> lockAllShards();
+    // Calls fn(shard, i) for every i < count with the shard of keyOf(i) locked. Each shard
+    // is locked once, in ascending order, and sees its positions in increasing order.
+    template <typename KeyOf, typename Fn>
+    void forEachByShard(size_t count, KeyOf&& keyOf, Fn&& fn);
+    // The set at each key (nullptr if missing), recording an access to each; throws
+    // WrongTypeError for a key of another type. Caller holds the keys' shards.
+    std::vector<const RedisObject*> lookupSets(const std::vector<std::string_view>& keys);
+    // Writes a snapshot of every shard to filename via a temporary file. The caller holds
+    // all shard locks, or is a forked child that has the keyspace to itself.
+    bool writeSnapshot(const std::string& filename, uint64_t& bytes);
+    // Waits for the background save child and records its outcome.
+    void reapSaveChild(pid_t pid, std::chrono::steady_clock::time_point started, const std::string& filename);
+    void recordSave(bool ok, long long duration_ms, uint64_t bytes);
+    // Decodes one snapshot section into the keyspace; false if it is malformed.
+    bool loadSection(const char* begin, const char* end, uint64_t keys);
+    bool loadLegacyText(const std::string& filename);
     
 };
 
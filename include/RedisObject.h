@@ -0,0 +1,510 @@
+#ifndef REDIS_OBJECT_H
+#define REDIS_OBJECT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <variant>
+#include <memory>
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+#include "Quicklist.h"
+#include "Listpack.h"
+#include "Dict.h"
+#include "SortedSet.h"
+#include "Intset.h"
+
+// Logical type of a value, as reported by TYPE.
+enum class ObjectType : uint8_t {
+    STRING,
+    LIST,
+    HASH,
+    ZSET,
+    SET
+};
+
+// Physical representation of a value. A type may gain more compact encodings
+// later without changing what TYPE reports.
+enum class ObjectEncoding : uint8_t {
+    RAW,       // STRING: std::string
+    EMBSTR,    // STRING of up to EmbeddedString::CAPACITY bytes, stored inside the object
+    INT,       // STRING that reads as a 64-bit integer, stored as one
+    QUICKLIST, // LIST: Quicklist
+    LISTPACK,  // HASH or ZSET, while small: Listpack
+    HASHTABLE, // HASH: Dict<std::string> of field -> value, boxed; SET: Dict of members, boxed
+    SKIPLIST,  // ZSET: SortedSet, boxed
+    INTSET     // SET of integers, while small: Intset
+};
+
+// Thrown when a command targets a key holding a different type.
+struct WrongTypeError : std::runtime_error {
+    WrongTypeError() : std::runtime_error("WRONGTYPE Operation against a key holding the wrong kind of value") {}
+};
+
+// Thrown when a command cannot apply to the value it finds (not a number, overflow,
+// too large). what() is the error reply, without the leading '-'.
+struct CommandError : std::runtime_error {
+    explicit CommandError(const std::string& message) : std::runtime_error(message) {}
+};
+
+// Wall-clock milliseconds since the Unix epoch; absolute expiry deadlines use this base.
+inline long long currentTimeMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Memory accounting helpers. Estimates follow what the allocator really hands out
+// (glibc malloc: 8-byte header, 16-byte granularity, 32-byte minimum chunk), so the
+// totals track RSS instead of just payload lengths.
+constexpr size_t mallocSize(size_t n) {
+    if (n == 0) return 0;
+    size_t chunk = (n + 8 + 15) & ~static_cast<size_t>(15);
+    return chunk < 32 ? 32 : chunk;
+}
+
+// Heap bytes behind a std::string of the given capacity (none while it fits in the
+// string's inline small-string buffer).
+inline size_t stringHeapBytes(size_t capacity) {
+    static const size_t inline_capacity = std::string().capacity();
+    return capacity <= inline_capacity ? 0 : mallocSize(capacity + 1);
+}
+inline size_t stringHeapBytes(const std::string& s) { return stringHeapBytes(s.capacity()); }
+
+// Short string kept in the object itself. It is sized to the largest other value
+// alternative, so it costs no room in the keyspace slot that is not already taken.
+struct EmbeddedString {
+    static constexpr size_t CAPACITY = 39;
+    char data[CAPACITY];
+    uint8_t len;
+    std::string_view view() const { return std::string_view(data, len); }
+};
+
+// A value stored in the keyspace. Every key maps to exactly one object, so type
+// checks, deletes and existence tests cost a single hash lookup.
+//
+// Objects live inline in the keyspace's slots, so the fewer bytes the value variant
+// takes, the smaller every slot. Large hash tables are therefore boxed, and strings
+// that fit in the space left over (EMBSTR) or read as integers (INT) need no heap
+// allocation at all. Sorted sets and hash sets are boxed for the same reason.
+struct RedisObject {
+    using List = Quicklist;
+    // HASHTABLE encoding: the same incrementally rehashed table as the keyspace, which
+    // also gives HSCAN a stable cursor. string_bytes is the heap bytes of its field and
+    // value strings, kept current by hashTableSet/hashTableErase so memoryUsage() need
+    // not walk the table.
+    struct Hash : Dict<std::string> {
+        size_t string_bytes = 0;
+    };
+    // HASHTABLE encoding of a set: the members are the keys. string_bytes as for Hash,
+    // kept current by setTableAdd/setTableErase.
+    struct Set : Dict<std::monostate> {
+        size_t string_bytes = 0;
+    };
+
+    ObjectType type;
+    ObjectEncoding encoding;
+    long long expire_at_ms = 0; // absolute deadline (see currentTimeMs()); 0 = no TTL
+    std::variant<std::string, EmbeddedString, long long, List, std::unique_ptr<Hash>, Listpack,
+                 std::unique_ptr<SortedSet>, Intset, std::unique_ptr<Set>> value;
+
+    // Room for the longest 64-bit integer in decimal, "-9223372036854775808".
+    static constexpr size_t INT_STR_SIZE = 20;
+
+    // Parses s as a 64-bit integer written the way it prints: an optional '-', no
+    // leading zeros, nothing else. Only such strings may become INT, so reading them
+    // back gives exactly the bytes that were stored.
+    static bool parseCanonicalInt(std::string_view s, long long& v) {
+        if (s.empty() || s.size() > INT_STR_SIZE) return false;
+        size_t digits = s[0] == '-' ? 1 : 0;
+        if (digits == s.size() || (s[digits] == '0' && s.size() > 1)) return false; // "-", "-0", "007"
+        auto res = std::from_chars(s.data(), s.data() + s.size(), v);
+        return res.ec == std::errc() && res.ptr == s.data() + s.size();
+    }
+
+    // Parses s as a finite floating point number, all of it (INCRBYFLOAT).
+    static bool parseLongDouble(std::string_view s, long double& v) {
+        if (s.empty() || s.size() > 5000 || std::isspace(static_cast<unsigned char>(s[0]))) return false;
+        std::string text(s); // strtold needs a terminator
+        char* end = nullptr;
+        errno = 0;
+        v = std::strtold(text.c_str(), &end);
+        return end == text.c_str() + text.size() && errno != ERANGE && std::isfinite(v);
+    }
+
+    static RedisObject makeString(std::string_view s) {
+        RedisObject obj{ObjectType::STRING, ObjectEncoding::RAW, 0, std::string()};
+        obj.setString(s);
+        return obj;
+    }
+    static RedisObject makeList() {
+        return RedisObject{ObjectType::LIST, ObjectEncoding::QUICKLIST, 0, List()};
+    }
+    // New hashes start as a listpack; see convertHashToTable().
+    static RedisObject makeHash() {
+        return RedisObject{ObjectType::HASH, ObjectEncoding::LISTPACK, 0, Listpack()};
+    }
+    // New sorted sets start as a listpack too; see convertZsetToSkiplist().
+    static RedisObject makeZset() {
+        return RedisObject{ObjectType::ZSET, ObjectEncoding::LISTPACK, 0, Listpack()};
+    }
+    // New sets start as an intset; see convertSetToTable().
+    static RedisObject makeSet() {
+        return RedisObject{ObjectType::SET, ObjectEncoding::INTSET, 0, Intset()};
+    }
+    static RedisObject makeEmpty(ObjectType type) {
+        switch (type) {
+            case ObjectType::LIST: return makeList();
+            case ObjectType::HASH: return makeHash();
+            case ObjectType::ZSET: return makeZset();
+            case ObjectType::SET: return makeSet();
+            default: return makeString("");
+        }
+    }
+
+    // Stores s in a STRING object, picking the most compact encoding for it. A RAW
+    // object reuses its buffer for another long value.
+    void setString(std::string_view s) {
+        long long v;
+        if (parseCanonicalInt(s, v)) {
+            value = v;
+            encoding = ObjectEncoding::INT;
+        } else if (s.size() <= EmbeddedString::CAPACITY) {
+            EmbeddedString e;
+            std::memcpy(e.data, s.data(), s.size());
+            e.len = static_cast<uint8_t>(s.size());
+            value = e;
+            encoding = ObjectEncoding::EMBSTR;
+        } else if (encoding == ObjectEncoding::RAW) {
+            std::get<std::string>(value).assign(s.data(), s.size());
+        } else {
+            value = std::string(s);
+            encoding = ObjectEncoding::RAW;
+        }
+    }
+    // The bytes of a STRING object. An INT is formatted into buf, so the view is valid
+    // while both the object (unmodified) and buf are.
+    std::string_view strView(char (&buf)[INT_STR_SIZE]) const {
+        switch (encoding) {
+            case ObjectEncoding::INT: {
+                auto res = std::to_chars(buf, buf + INT_STR_SIZE, std::get<long long>(value));
+                return std::string_view(buf, res.ptr - buf);
+            }
+            case ObjectEncoding::EMBSTR:
+                return std::get<EmbeddedString>(value).view();
+            default:
+                return std::get<std::string>(value);
+        }
+    }
+    std::string strValue() const {
+        char buf[INT_STR_SIZE];
+        return std::string(strView(buf));
+    }
+    // The value of a STRING object as an integer; false if it does not read as one.
+    bool getInt(long long& v) const {
+        if (encoding == ObjectEncoding::INT) {
+            v = std::get<long long>(value);
+            return true;
+        }
+        char buf[INT_STR_SIZE];
+        return parseCanonicalInt(strView(buf), v);
+    }
+    void setInt(long long v) {
+        value = v;
+        encoding = ObjectEncoding::INT;
+    }
+    // The value of a STRING object as a RAW string that can be edited in place,
+    // converting it first if it is encoded otherwise.
+    std::string& rawString() {
+        if (encoding != ObjectEncoding::RAW) {
+            std::string s(strValue());
+            value = std::move(s);
+            encoding = ObjectEncoding::RAW;
+        }
+        return std::get<std::string>(value);
+    }
+
+    List& list() { return std::get<List>(value); }
+    const List& list() const { return std::get<List>(value); }
+    // HASHTABLE-encoded hash; packedHash() is the LISTPACK one.
+    Hash& hash() { return *std::get<std::unique_ptr<Hash>>(value); }
+    const Hash& hash() const { return *std::get<std::unique_ptr<Hash>>(value); }
+    Listpack& packedHash() { return std::get<Listpack>(value); }
+    const Listpack& packedHash() const { return std::get<Listpack>(value); }
+    // SKIPLIST-encoded sorted set; packedZset() is the LISTPACK one.
+    SortedSet& zset() { return *std::get<std::unique_ptr<SortedSet>>(value); }
+    const SortedSet& zset() const { return *std::get<std::unique_ptr<SortedSet>>(value); }
+    Listpack& packedZset() { return std::get<Listpack>(value); }
+    const Listpack& packedZset() const { return std::get<Listpack>(value); }
+    // HASHTABLE-encoded set; intset() is the INTSET one.
+    Set& set() { return *std::get<std::unique_ptr<Set>>(value); }
+    const Set& set() const { return *std::get<std::unique_ptr<Set>>(value); }
+    Intset& intset() { return std::get<Intset>(value); }
+    const Intset& intset() const { return std::get<Intset>(value); }
+
+    // Read access to a hash in either encoding.
+    size_t hashSize() const {
+        return encoding == ObjectEncoding::LISTPACK ? packedHash().size() : hash().size();
+    }
+    bool hashGet(std::string_view field, std::string_view& out) const {
+        if (encoding == ObjectEncoding::LISTPACK) return packedHash().find(field, out);
+        const std::string* val = hash().find(field);
+        if (val == nullptr) return false;
+        out = *val;
+        return true;
+    }
+    // Calls fn(std::string_view field, std::string_view value) for every field.
+    template <typename Fn>
+    void hashForEach(Fn&& fn) const {
+        if (encoding == ObjectEncoding::LISTPACK) {
+            packedHash().forEach(fn);
+        } else {
+            hash().forEach([&fn](const std::string& field, const std::string& val) {
+                fn(std::string_view(field), std::string_view(val));
+            });
+        }
+    }
+    // Re-encodes a LISTPACK hash as a hash table, once it outgrows the listpack limits.
+    void convertHashToTable() {
+        auto table = std::make_unique<Hash>();
+        table->reserve(packedHash().size());
+        Listpack packed = std::move(packedHash());
+        value = std::move(table);
+        encoding = ObjectEncoding::HASHTABLE;
+        packed.forEach([this](std::string_view field, std::string_view val) { hashTableSet(field, val); });
+    }
+    // Sets field in a HASHTABLE hash; true if it was added.
+    bool hashTableSet(std::string_view field, std::string_view val) {
+        Hash& table = hash();
+        auto res = table.emplace(field, std::string());
+        if (res.second) table.string_bytes += stringHeapBytes(field.size());
+        table.string_bytes -= stringHeapBytes(*res.first);
+        res.first->assign(val.data(), val.size());
+        table.string_bytes += stringHeapBytes(*res.first);
+        return res.second;
+    }
+    bool hashTableErase(std::string_view field) {
+        Hash& table = hash();
+        std::optional<std::string> val = table.take(field);
+        if (!val) return false;
+        table.string_bytes -= stringHeapBytes(field.size()) + stringHeapBytes(*val);
+        return true;
+    }
+
+    // A LISTPACK sorted set keeps its pairs ordered by (score, member), each score as
+    // the 8 bytes of the double, so reading one back is a copy rather than a parse.
+    static std::string_view packScore(double score, char (&buf)[sizeof(double)]) {
+        std::memcpy(buf, &score, sizeof(double));
+        return std::string_view(buf, sizeof(double));
+    }
+    static double unpackScore(std::string_view packed) {
+        double score;
+        std::memcpy(&score, packed.data(), sizeof(double));
+        return score;
+    }
+
+    // Read access to a sorted set in either encoding. Ranks are 0-based, ascending.
+    size_t zsetSize() const {
+        return encoding == ObjectEncoding::LISTPACK ? packedZset().size() : zset().size();
+    }
+    bool zsetScore(std::string_view member, double& score) const {
+        if (encoding != ObjectEncoding::LISTPACK) return zset().score(member, score);
+        std::string_view packed;
+        if (!packedZset().find(member, packed)) return false;
+        score = unpackScore(packed);
+        return true;
+    }
+    bool zsetRank(std::string_view member, size_t& rank) const {
+        if (encoding != ObjectEncoding::LISTPACK) return zset().rank(member, rank);
+        bool found = false;
+        size_t index = 0;
+        packedZset().forEach([&](std::string_view m, std::string_view) {
+            if (m == member) {
+                found = true;
+                rank = index;
+            }
+            ++index;
+        });
+        return found;
+    }
+    // See SortedSet::countBelow() and countUpTo().
+    size_t zsetCountBelow(const ScoreRange& range) const {
+        if (encoding != ObjectEncoding::LISTPACK) return zset().countBelow(range);
+        size_t n = 0;
+        packedZset().forEach([&](std::string_view, std::string_view packed) {
+            if (!range.aboveMin(unpackScore(packed))) ++n;
+        });
+        return n;
+    }
+    size_t zsetCountUpTo(const ScoreRange& range) const {
+        if (encoding != ObjectEncoding::LISTPACK) return zset().countUpTo(range);
+        size_t n = 0;
+        packedZset().forEach([&](std::string_view, std::string_view packed) {
+            if (range.belowMax(unpackScore(packed))) ++n;
+        });
+        return n;
+    }
+    // Calls fn(std::string_view member, double score) for ranks [start, end), ascending,
+    // or descending from end - 1 if reverse.
+    template <typename Fn>
+    void zsetForRanks(size_t start, size_t end, bool reverse, Fn&& fn) const {
+        if (encoding != ObjectEncoding::LISTPACK) {
+            zset().forRanks(start, end, reverse, fn);
+            return;
+        }
+        std::vector<std::pair<std::string_view, double>> pairs;
+        size_t index = 0;
+        packedZset().forEach([&](std::string_view member, std::string_view packed) {
+            if (index >= start && index < end) pairs.emplace_back(member, unpackScore(packed));
+            ++index;
+        });
+        if (reverse) std::reverse(pairs.begin(), pairs.end());
+        for (const auto& [member, score] : pairs) fn(member, score);
+    }
+    template <typename Fn>
+    void zsetForEach(Fn&& fn) const {
+        zsetForRanks(0, zsetSize(), false, fn);
+    }
+    // Re-encodes a LISTPACK sorted set as a skiplist, once it outgrows the listpack limits.
+    void convertZsetToSkiplist() {
+        auto set = std::make_unique<SortedSet>();
+        set->reserve(packedZset().size());
+        packedZset().forEach([&set](std::string_view member, std::string_view packed) {
+            set->set(member, unpackScore(packed));
+        });
+        value = std::move(set);
+        encoding = ObjectEncoding::SKIPLIST;
+    }
+
+    // Read access to a set in either encoding.
+    size_t setSize() const {
+        return encoding == ObjectEncoding::INTSET ? intset().size() : set().size();
+    }
+    bool setContains(std::string_view member) const {
+        if (encoding != ObjectEncoding::INTSET) return set().find(member) != nullptr;
+        long long v;
+        return parseCanonicalInt(member, v) && intset().contains(v);
+    }
+    // Calls fn(std::string_view member) for every member (an intset's in ascending
+    // order). The view is only valid during the call.
+    template <typename Fn>
+    void setForEach(Fn&& fn) const {
+        if (encoding == ObjectEncoding::INTSET) {
+            char buf[INT_STR_SIZE];
+            intset().forEach([&](int64_t v) {
+                auto res = std::to_chars(buf, buf + INT_STR_SIZE, v);
+                fn(std::string_view(buf, res.ptr - buf));
+            });
+        } else {
+            set().forEach([&fn](const std::string& member, std::monostate) { fn(std::string_view(member)); });
+        }
+    }
+    // Re-encodes an INTSET set as a hash table, once it outgrows set-max-intset-entries
+    // or gains a member that is not an integer.
+    void convertSetToTable() {
+        auto table = std::make_unique<Set>();
+        table->reserve(intset().size());
+        Intset ints = std::move(intset());
+        value = std::move(table);
+        encoding = ObjectEncoding::HASHTABLE;
+        char buf[INT_STR_SIZE];
+        ints.forEach([&](int64_t v) {
+            auto res = std::to_chars(buf, buf + INT_STR_SIZE, v);
+            setTableAdd(std::string_view(buf, res.ptr - buf));
+        });
+    }
+    // Adds member to a HASHTABLE set; true if it was absent.
+    bool setTableAdd(std::string_view member) {
+        Set& table = set();
+        bool added = table.emplace(member, std::monostate()).second;
+        if (added) table.string_bytes += stringHeapBytes(member.size());
+        return added;
+    }
+    bool setTableErase(std::string_view member) {
+        Set& table = set();
+        if (!table.erase(member)) return false;
+        table.string_bytes -= stringHeapBytes(member.size());
+        return true;
+    }
+
+    // Heap bytes of the value's own structure: a RAW string's buffer, the list's nodes
+    // and blocks (elements included), the listpack buffer, or the hash table's box,
+    // slot array, the intset's array, or the whole sorted set. Hash table strings are
+    // not included (see memoryUsage()).
+    // O(1), so it can be taken before and after a mutation.
+    size_t containerBytes() const {
+        switch (type) {
+            case ObjectType::STRING:
+                return encoding == ObjectEncoding::RAW ? stringHeapBytes(std::get<std::string>(value)) : 0;
+            case ObjectType::LIST:
+                return list().memoryUsage();
+            case ObjectType::HASH:
+                if (encoding == ObjectEncoding::LISTPACK) return packedHash().memoryUsage();
+                return mallocSize(sizeof(Hash)) + hash().tableBytes();
+            case ObjectType::ZSET:
+                if (encoding == ObjectEncoding::LISTPACK) return packedZset().memoryUsage();
+                return zset().memoryUsage();
+            case ObjectType::SET:
+                if (encoding == ObjectEncoding::INTSET) return intset().memoryUsage();
+                return mallocSize(sizeof(Set)) + set().tableBytes();
+        }
+        return 0;
+    }
+
+    // Every heap byte the value owns.
+    size_t memoryUsage() const {
+        size_t bytes = containerBytes();
+        if (encoding == ObjectEncoding::HASHTABLE) {
+            bytes += type == ObjectType::HASH ? hash().string_bytes : set().string_bytes;
+        }
+        return bytes;
+    }
+
+    // Roughly how many allocations destroying the value releases (Redis' free effort);
+    // LazyFree hands values above its threshold to a background thread.
+    size_t freeEffort() const {
+        switch (encoding) {
+            case ObjectEncoding::QUICKLIST: return list().nodeCount();
+            case ObjectEncoding::HASHTABLE: return type == ObjectType::HASH ? hash().size() : set().size();
+            case ObjectEncoding::SKIPLIST: return zset().size();
+            default: return 1;
+        }
+    }
+
+    bool hasExpire() const { return expire_at_ms > 0; }
+    bool isExpiredAt(long long now_ms) const { return expire_at_ms > 0 && expire_at_ms <= now_ms; }
+
+    const char* typeName() const {
+        switch (type) {
+            case ObjectType::STRING: return "string";
+            case ObjectType::LIST: return "list";
+            case ObjectType::HASH: return "hash";
+            case ObjectType::ZSET: return "zset";
+            case ObjectType::SET: return "set";
+        }
+        return "none";
+    }
+
+    // As reported by OBJECT ENCODING.
+    const char* encodingName() const {
+        switch (encoding) {
+            case ObjectEncoding::RAW: return "raw";
+            case ObjectEncoding::EMBSTR: return "embstr";
+            case ObjectEncoding::INT: return "int";
+            case ObjectEncoding::QUICKLIST: return "quicklist";
+            case ObjectEncoding::LISTPACK: return "listpack";
+            case ObjectEncoding::HASHTABLE: return "hashtable";
+            case ObjectEncoding::SKIPLIST: return "skiplist";
+            case ObjectEncoding::INTSET: return "intset";
+        }
+        return "unknown";
+    }
+};
+
+#endif // REDIS_OBJECT_H
@@ -3,7 +3,12 @@
 
 #include<string>//signal handling
 #include<atomic>
-#include "D:\\projects\\Enhanced-Redis\\include\\ThreadPool.h" // Include ThreadPool header
+#include<memory>
+#include<mutex>
+#include<unordered_map>
+#include "ThreadPool.h" // Include ThreadPool header
+#include "RespParser.h"
+#include "RedisCommandHandler.h"
 
 class RedisServer{
 public:
@@ -11,13 +16,40 @@ public:
     void run();
     void shutdown();
 private:
+    // Per-client state owned by the event loop. A connection is armed in epoll with
+    // EPOLLONESHOT, so at most one pool worker touches it at any time.
+    struct Connection {
+        int fd;
+        std::string read_buffer;  // bytes received but not yet executed
+        RespParser parser;        // resumes partially received commands in read_buffer
+        std::string write_buffer; // replies not yet accepted by the kernel
+        size_t write_offset = 0;  // how much of write_buffer has already been sent
+        bool close_after_write = false; // set after a protocol error
+        explicit Connection(int fd) : fd(fd) {}
+    };
+
     int port;
     int server_socket;
+    int epoll_fd;
     std::atomic<bool> running;
+    // A single command handler instance is shared by all workers; its state lives in
+    // RedisDatabase, which does its own locking. Declared before thread_pool so the
+    // workers are joined before it is destroyed.
+    RedisCommandHandler cmdHandler;
     ThreadPool thread_pool; // Add a ThreadPool member
 
+    std::mutex connections_mutex;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+
     //Setup signal handlers for graceful shutdown (crtl +c)
     void setupSignalHandler();
 
+    // Event loop helpers
+    void acceptConnections();
+    void serviceConnection(Connection* conn);
+    bool flushWrites(Connection* conn); // false on a fatal socket error
+    void rearmConnection(Connection* conn);
+    void closeConnection(Connection* conn);
+
 };
-#endif
\ No newline at end of file
+#endif
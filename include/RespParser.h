@@ -0,0 +1,92 @@
+#ifndef RESP_PARSER_H
+#define RESP_PARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+// Arguments of one parsed command. Each argument is a view into the buffer that was
+// parsed, so building a command copies no argument bytes. Views stay valid until that
+// buffer is next modified; anything kept longer (stored keys/values) must be copied.
+// Typical commands fit in the inline array, so no heap allocation happens at all.
+class CommandArgs {
+public:
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const std::string_view& operator[](size_t i) const { return data()[i]; }
+    const std::string_view* begin() const { return data(); }
+    const std::string_view* end() const { return data() + count; }
+
+    void push_back(std::string_view arg) {
+        if (count < INLINE_ARGS) {
+            inline_args[count++] = arg;
+            return;
+        }
+        if (count == INLINE_ARGS) {
+            overflow.assign(inline_args, inline_args + INLINE_ARGS);
+        }
+        overflow.push_back(arg);
+        count++;
+    }
+    void clear() {
+        count = 0;
+        overflow.clear(); // keeps capacity for the next long command
+    }
+
+private:
+    static constexpr size_t INLINE_ARGS = 8;
+    std::string_view inline_args[INLINE_ARGS];
+    std::vector<std::string_view> overflow; // used once a command has more than INLINE_ARGS arguments
+    size_t count = 0;
+
+    const std::string_view* data() const { return count <= INLINE_ARGS ? inline_args : overflow.data(); }
+};
+
+// Incremental parser for client requests.
+// One instance lives with each connection and is fed the connection's growing
+// read buffer. Parsing state survives between calls, so a command split across
+// several recv() calls is resumed where it stopped instead of being re-scanned,
+// and every complete command in the buffer is returned in order (pipelining).
+//
+// Accepts RESP arrays of bulk strings (*N\r\n$len\r\n...\r\n) and, like Redis,
+// plain inline commands terminated by a newline.
+class RespParser {
+public:
+    enum Result {
+        COMMAND_READY,  // args holds the next command
+        NEED_MORE,      // the buffer ends inside a command; read more and call again
+        PROTOCOL_ERROR  // malformed input; see errorMessage()
+    };
+
+    // Parses the next command from buffer. Internal offsets are relative to the start of
+    // buffer, so the buffer may grow (and be reallocated) between calls. The returned
+    // args point into buffer and are only valid until it is modified.
+    Result next(const std::string& buffer, CommandArgs& args);
+
+    // Erases the bytes of all commands already returned from the front of buffer
+    // and rebases the parser onto the shortened buffer.
+    void discardConsumed(std::string& buffer);
+
+    const std::string& errorMessage() const { return error; }
+
+private:
+    // Hard limits, mirroring Redis' defaults, so a bad client cannot make us buffer forever.
+    static constexpr size_t MAX_INLINE_SIZE = 64 * 1024;
+    static constexpr long long MAX_BULK_LEN = 512LL * 1024 * 1024;
+    static constexpr long long MAX_MULTIBULK_LEN = 1024 * 1024;
+
+    size_t consumed = 0;          // end of the last complete command
+    size_t cursor = 0;            // next byte to examine
+    long long args_remaining = -1; // -1 while waiting for the next '*' header
+    long long bulk_len = -1;      // -1 while waiting for the next '$' header
+    std::vector<std::pair<size_t, size_t>> arg_spans; // (offset,length) of parsed bulk strings
+    std::string error;
+
+    Result parseInline(const std::string& buffer, CommandArgs& args);
+    Result fail(const std::string& message);
+    // Reads a "<prefix><integer>\r\n" line at cursor. Returns false when the line is incomplete.
+    bool readLength(const std::string& buffer, long long& value, bool& malformed);
+};
+
+#endif // RESP_PARSER_H
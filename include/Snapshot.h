@@ -0,0 +1,132 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Binary snapshot format (dump.my_rdb):
+//
+//   "SCDB" <version:1 byte>
+//   section...                              one per keyspace shard
+//   SNAP_SECTION_INDEX <count:varint> (<offset:8 bytes LE> <keys:varint>)...
+//   <index offset:8 bytes LE>
+//   SNAP_EOF <crc32c:4 bytes LE>
+//
+// A section is a run of records, each an opcode byte followed by its payload. Strings
+// are a varint length followed by the raw bytes, so values may contain any byte. The
+// trailing index lets a loader find every section without decoding the ones before
+// it, so sections can be decoded in parallel. The CRC covers everything before it.
+//
+//   SNAP_EXPIRE_MS <deadline:8 bytes LE>    applies to the key record that follows
+//   SNAP_KEY_STATS <accesses:varint> <last access:varint> <ttl:varint>
+//                                           eviction metadata of the key record that
+//                                           follows: last access is Unix time in ms, ttl
+//                                           the full TTL in ms the deadline was set with
+//   SNAP_STRING <key> <value>
+//   SNAP_LIST   <key> <count:varint> <element>...
+//   SNAP_HASH   <key> <count:varint> (<field> <value>)...
+//   SNAP_ZSET   <key> <count:varint> (<member> <score:8 bytes LE, IEEE 754 double>)...
+//                                           members in ascending (score, member) order
+//   SNAP_SET    <key> <count:varint> <member>...
+//
+// Version 1 files have no index: their records form a single section ending at SNAP_EOF.
+// Version 2 files carry no SNAP_KEY_STATS records, versions 2 and 3 no SNAP_ZSET, and
+// versions 2 to 4 no SNAP_SET.
+enum SnapshotOpcode : uint8_t {
+    SNAP_STRING        = 0,
+    SNAP_LIST          = 1,
+    SNAP_HASH          = 2,
+    SNAP_ZSET          = 3,
+    SNAP_SET           = 4,
+    SNAP_KEY_STATS     = 0xFB,
+    SNAP_EXPIRE_MS     = 0xFC,
+    SNAP_SECTION_INDEX = 0xFE,
+    SNAP_EOF           = 0xFF
+};
+
+constexpr char SNAPSHOT_MAGIC[4] = {'S', 'C', 'D', 'B'};
+constexpr uint8_t SNAPSHOT_VERSION = 5;
+// Smallest possible key record: SNAP_STRING with an empty key and value. Bounds the
+// key count a section of a given size can claim.
+constexpr size_t SNAPSHOT_MIN_RECORD_SIZE = 3;
+
+struct SnapshotSection {
+    uint64_t offset; // where its records start in the file
+    uint64_t keys;   // number of keys it holds (a sizing hint)
+};
+
+// CRC-32C (Castagnoli), using the SSE4.2 instruction when the CPU has it.
+uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+
+// Buffered, checksummed writer. Bytes are staged in a large buffer and written
+// with one fwrite per buffer, never per token.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(FILE* file) : file(file) { buffer.reserve(BUFFER_SIZE); }
+
+    void writeHeader();
+    void writeByte(uint8_t b) { buffer.push_back(static_cast<char>(b)); maybeFlush(); }
+    void writeVarint(uint64_t v);
+    void writeFixed64(uint64_t v);
+    void writeString(std::string_view s);
+    // Writes the section index; call once every section has been written.
+    void writeSectionIndex(const std::vector<SnapshotSection>& sections);
+    // Writes SNAP_EOF and the checksum, then flushes. Returns false on any I/O error.
+    bool finish();
+
+    uint64_t bytesWritten() const { return written + buffer.size(); }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    FILE* file;
+    std::string buffer;
+    uint32_t crc = 0;
+    uint64_t written = 0;
+    bool failed = false;
+
+    void maybeFlush() { if (buffer.size() >= BUFFER_SIZE) flush(); }
+    void flush();
+};
+
+// Bounds-checked decoder over part of a snapshot held in memory (the loader maps the
+// whole file). Strings are returned as views into that memory. Every read method
+// returns false on truncated or malformed input.
+class SnapshotReader {
+public:
+    SnapshotReader(const char* begin, const char* end) : pos(begin), end(end) {}
+
+    bool atEnd() const { return pos == end; }
+    bool readByte(uint8_t& b);
+    bool readVarint(uint64_t& v);
+    bool readFixed64(uint64_t& v);
+    bool readString(std::string_view& s);
+
+private:
+    const char* pos;
+    const char* end;
+};
+
+// Where the sections of a mapped snapshot lie, as [begin, end) byte ranges.
+struct SnapshotLayout {
+    struct Range {
+        const char* begin;
+        const char* end;
+        uint64_t keys;
+    };
+    std::vector<Range> sections;
+    size_t checksummed = 0; // bytes covered by the stored CRC
+    uint32_t stored_crc = 0;
+};
+
+// Checks magic, version and trailer of a snapshot of size bytes at data and locates
+// its sections. False if it is not a snapshot this version can read, or is damaged.
+// The CRC itself is not verified here: it is left to the caller so that it can run
+// alongside decoding.
+bool parseSnapshotLayout(const char* data, size_t size, SnapshotLayout& layout);
+
+#endif // SNAPSHOT_H
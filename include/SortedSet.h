@@ -0,0 +1,117 @@
+#ifndef SORTED_SET_H
+#define SORTED_SET_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include "Dict.h"
+
+// Score interval of a range query (ZRANGEBYSCORE, ZCOUNT): min..max, either end
+// optionally exclusive.
+struct ScoreRange {
+    double min;
+    double max;
+    bool min_exclusive = false;
+    bool max_exclusive = false;
+
+    bool aboveMin(double score) const { return min_exclusive ? score > min : score >= min; }
+    bool belowMax(double score) const { return max_exclusive ? score < max : score <= max; }
+};
+
+// Sorted set value once it outgrows the listpack encoding (Redis' skiplist encoding).
+//
+// Elements are kept in a skiplist ordered by (score, member). Every link also records
+// how many elements it skips, so besides finding a score, the rank of an element and
+// the element at a rank are O(log n) too: ZRANK, ZRANGE and ZCOUNT never walk the
+// elements they skip. A member -> score table answers ZSCORE in O(1) and gives the
+// score needed to find a member's node.
+class SortedSet {
+public:
+    SortedSet();
+    ~SortedSet();
+    SortedSet(const SortedSet&) = delete;
+    SortedSet& operator=(const SortedSet&) = delete;
+
+    size_t size() const { return length; }
+    void reserve(size_t n) { scores.reserve(n); }
+
+    bool score(std::string_view member, double& score) const;
+    // Adds member with score, or moves it to score. Returns true if it was added.
+    bool set(std::string_view member, double score);
+    bool erase(std::string_view member);
+
+    // 0-based rank of member in ascending order; false if it is absent.
+    bool rank(std::string_view member, size_t& rank) const;
+    // Number of elements below range's min bound, and number not above its max bound:
+    // the elements in range are the ranks from the first to just before the second.
+    size_t countBelow(const ScoreRange& range) const;
+    size_t countUpTo(const ScoreRange& range) const;
+
+    // Calls fn(std::string_view member, double score) for ranks [start, end) in
+    // ascending order, or from end - 1 down to start if reverse.
+    template <typename Fn>
+    void forRanks(size_t start, size_t end, bool reverse, Fn&& fn) const {
+        if (start >= end) return;
+        const Node* n = nodeAt(reverse ? end - 1 : start);
+        for (size_t i = start; i < end; ++i) {
+            fn(std::string_view(n->member), n->score);
+            n = reverse ? n->backward : n->levels()[0].forward;
+        }
+    }
+    // Calls fn(std::string_view member, double score) for every element, ascending.
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        forRanks(0, length, false, fn);
+    }
+
+    // Heap bytes of the set, members included; kept current, so O(1).
+    size_t memoryUsage() const;
+
+    // Scores as read and written by commands: "inf", "+inf" and "-inf" included, NaN
+    // refused. Formatting gives the shortest text that reads back as the same double.
+    static constexpr size_t SCORE_STR_SIZE = 32;
+    static bool parseScore(std::string_view text, double& score);
+    static std::string_view formatScore(double score, char (&buf)[SCORE_STR_SIZE]);
+
+private:
+    // Levels are drawn with probability 1/4 each, as in Redis: with 32 of them the
+    // list stays logarithmic far beyond any size that fits in memory.
+    static constexpr int MAX_LEVEL = 32;
+
+    struct Node;
+    struct Level {
+        Node* forward;
+        size_t span; // elements between this node and forward, counting forward
+    };
+    // A node is allocated with its Level array right behind it.
+    struct Node {
+        std::string member;
+        double score;
+        Node* backward;
+        int height; // entries in the Level array
+        Level* levels() { return reinterpret_cast<Level*>(this + 1); }
+        const Level* levels() const { return reinterpret_cast<const Level*>(this + 1); }
+    };
+
+    Node* header;
+    int level = 1;    // levels in use
+    size_t length = 0;
+    size_t bytes = 0; // nodes, member strings and the table's key copies
+    Dict<double> scores;
+
+    static Node* createNode(int levels, std::string_view member, double score);
+    static void destroyNode(Node* n);
+    static size_t nodeBytes(int levels);
+    static int randomLevel();
+    // Whether the element (score, member) sorts before node n.
+    static bool before(const Node* n, double score, std::string_view member) {
+        return n->score < score || (n->score == score && n->member < member);
+    }
+
+    void insertNode(std::string_view member, double score);
+    void eraseNode(std::string_view member, double score);
+    const Node* nodeAt(size_t rank) const; // 0-based, rank < length
+};
+
+#endif // SORTED_SET_H
@@ -0,0 +1,17 @@
+#ifndef STRING_MATCH_H
+#define STRING_MATCH_H
+
+#include <string_view>
+
+// Glob-style matching as in Redis' KEYS and SCAN MATCH:
+//
+//   *        any run of characters, including none
+//   ?        any one character
+//   [abc]    one of the listed characters; [^abc] anything else; [a-z] a range
+//   \x       the character x itself
+//
+// Runs in O(pattern * str) at worst: a '*' is retried from the latest one only,
+// which is enough since every other token matches exactly one character.
+bool stringMatch(std::string_view pattern, std::string_view str, bool nocase = false);
+
+#endif // STRING_MATCH_H
@@ -13,6 +13,8 @@ class ThreadPool {
 public:
     ThreadPool(size_t num_threads);
     ~ThreadPool();
+    // Runs the tasks already queued, then joins the workers; later enqueues throw.
+    void shutdown();
 
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args) 
@@ -49,4 +51,7 @@ private:
     // Synchronization
     std::mutex queue_mutex;
     std::condition_variable condition;
-    bool stop;
\ No newline at end of file
+    bool stop;
+};
+
+#endif // THREAD_POOL_H
@@ -1,47 +1,47 @@
-#include "D:\\projects\\Enhanced-Redis\\include\\AdaptivePredictiveCache.h"
+#include "../include/AdaptivePredictiveCache.h"
+#include "../include/RedisObject.h" // stringHeapBytes
 #include <algorithm> // For std::min, std::max
 
-void AdaptivePredictiveCache::recordAccess(const std::string& key) {
+KeyStats& AdaptivePredictiveCache::statsFor(std::string_view key) {
+    KeyStats* stats = meta_store.find(key);
+    if (stats == nullptr) {
+        stats = meta_store.emplace(key, KeyStats()).first;
+        key_bytes += stringHeapBytes(key.size());
+    }
+    return *stats;
+}
+
+void AdaptivePredictiveCache::recordAccess(std::string_view key) {
     // If the key doesn't exist, create it with default stats.
     // If it exists, update its stats.
-    KeyStats& stats = meta_store[key]; 
+    KeyStats& stats = statsFor(key);
     stats.access_count++;
     stats.last_access = getCurrentTime();
-    updateScore(key);
+    computeScore(stats, stats.last_access);
 }
 
-void AdaptivePredictiveCache::setTTL(const std::string& key, double ttl_seconds) {
-    KeyStats& stats = meta_store[key];
+void AdaptivePredictiveCache::setTTL(std::string_view key, double ttl_seconds) {
+    KeyStats& stats = statsFor(key);
     stats.ttl_initial_seconds = ttl_seconds;
     stats.ttl_set_time = getCurrentTime();
-    stats.last_access = getCurrentTime(); // TTL setting is also an access
-    updateScore(key);
+    stats.last_access = stats.ttl_set_time; // TTL setting is also an access
+    computeScore(stats, stats.last_access);
 }
 
-double AdaptivePredictiveCache::getTTLRemaining(const std::string& key) const {
-    auto it = meta_store.find(key);
-    if (it == meta_store.end() || it->second.ttl_initial_seconds <= 0) {
+double AdaptivePredictiveCache::getTTLRemaining(std::string_view key) const {
+    const KeyStats* s = meta_store.find(key);
+    if (s == nullptr || s->ttl_initial_seconds <= 0) {
         return 0.0; // No TTL set or key doesn't exist
     }
 
-    const KeyStats& s = it->second;
     auto now = getCurrentTime();
-    double elapsed_seconds = std::chrono::duration_cast<std::chrono::seconds>(now - s.ttl_set_time).count();
+    double elapsed_seconds = std::chrono::duration<double>(now - s->ttl_set_time).count(); // sub-second TTLs need the fraction
     
     // The remaining TTL should not go below zero
-    return std::max(0.0, s.ttl_initial_seconds - elapsed_seconds);
+    return std::max(0.0, s->ttl_initial_seconds - elapsed_seconds);
 }
 
-void AdaptivePredictiveCache::updateScore(const std::string& key) {
-    auto it = meta_store.find(key);
-    if (it == meta_store.end()) {
-        // Key not in meta_store, cannot update score
-        return;
-    }
-
-    KeyStats& s = it->second;
-    auto now = getCurrentTime();
-
+void AdaptivePredictiveCache::computeScore(KeyStats& s, std::chrono::steady_clock::time_point now) const {
     // RecencyFactor = 1 / (1 + time_since_last_access)
     double time_since_last_access_seconds = std::chrono::duration_cast<std::chrono::seconds>(now - s.last_access).count();
     double recency_factor = 1.0 / (1.0 + time_since_last_access_seconds);
@@ -52,7 +52,8 @@ void AdaptivePredictiveCache::updateScore(const std::string& key) {
     // TTLFactor = ttl_remaining / ttl_total (if TTL exists)
     double ttl_factor = 0.0;
     if (s.ttl_initial_seconds > 0) {
-        double current_ttl_remaining = getTTLRemaining(key);
+        double elapsed_seconds = std::chrono::duration<double>(now - s.ttl_set_time).count();
+        double current_ttl_remaining = std::max(0.0, s.ttl_initial_seconds - elapsed_seconds);
         if (current_ttl_remaining <= 0) {
             // Key has expired, assign a very low score
             s.score = -std::numeric_limits<double>::max(); // Effectively mark for immediate eviction
@@ -64,56 +65,111 @@ void AdaptivePredictiveCache::updateScore(const std::string& key) {
     s.score = ALPHA * recency_factor + BETA * frequency_factor + GAMMA * ttl_factor;
 }
 
+void AdaptivePredictiveCache::updateScore(std::string_view key) {
+    KeyStats* s = meta_store.find(key);
+    if (s == nullptr) {
+        // Key not in meta_store, cannot update score
+        return;
+    }
+    computeScore(*s, getCurrentTime());
+}
+
+void AdaptivePredictiveCache::addToEvictionPool(std::string_view key, double score) {
+    // A key sampled again replaces its older (staler) pool entry
+    for (auto it = eviction_pool.begin(); it != eviction_pool.end(); ++it) {
+        if (it->key == key) {
+            eviction_pool.erase(it);
+            break;
+        }
+    }
+    if (eviction_pool.size() >= EVICTION_POOL_SIZE && score >= eviction_pool.back().score) {
+        return; // Worse than every candidate we already hold
+    }
+    auto pos = std::upper_bound(eviction_pool.begin(), eviction_pool.end(), score,
+        [](double value, const EvictionCandidate& c) { return value < c.score; });
+    eviction_pool.insert(pos, EvictionCandidate{std::string(key), score});
+    if (eviction_pool.size() > EVICTION_POOL_SIZE) {
+        eviction_pool.pop_back();
+    }
+}
+
 std::string AdaptivePredictiveCache::evictCandidate() {
-    std::string lowestKey;
-    double lowestScore = std::numeric_limits<double>::max();
-    bool foundCandidate = false;
-
-    // Iterate through all keys to find the one with the lowest score
-    // Also update scores for accuracy, especially TTL-based ones
-    for (auto& pair : meta_store) {
-        const std::string& key = pair.first;
-        updateScore(key); // Ensure score is up-to-date
-
-        // Check if the key has effectively expired
-        if (getTTLRemaining(key) <= 0 && meta_store[key].ttl_initial_seconds > 0) {
-            lowestKey = key;
-            return lowestKey; // Prioritize already expired keys for eviction
+    if (meta_store.empty()) {
+        eviction_pool.clear();
+        return "";
+    }
+
+    // Score a few random keys and merge them into the pool of best candidates
+    auto now = getCurrentTime();
+    std::string bestSampled;
+    double bestSampledScore = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < EVICTION_SAMPLES; ++i) {
+        auto* entry = meta_store.sample(rng());
+        computeScore(entry->value, now); // Ensure score is up-to-date
+
+        if (entry->value.score == -std::numeric_limits<double>::max()) {
+            return entry->key; // Prioritize already expired keys for eviction
         }
-        
-        if (meta_store[key].score < lowestScore) {
-            lowestScore = meta_store[key].score;
-            lowestKey = key;
-            foundCandidate = true;
+        addToEvictionPool(entry->key, entry->value.score);
+        if (entry->value.score < bestSampledScore) {
+            bestSampledScore = entry->value.score;
+            bestSampled = entry->key;
         }
     }
-    
-    if (!foundCandidate && !meta_store.empty()) {
-        // Fallback: if no score was explicitly lower, just pick the first one
-        // This case might happen if all scores are identical (e.g., all 0.0 for new keys)
-        return meta_store.begin()->first;
+
+    // Pool entries can outlive their keys (deleted or already evicted); skip those
+    while (!eviction_pool.empty()) {
+        std::string key = std::move(eviction_pool.front().key);
+        eviction_pool.erase(eviction_pool.begin());
+        if (meta_store.find(key) != nullptr) {
+            return key;
+        }
     }
+    return bestSampled;
+}
 
-    return lowestKey;
+void AdaptivePredictiveCache::removeKey(std::string_view key) {
+    if (meta_store.erase(key)) {
+        key_bytes -= stringHeapBytes(key.size());
+    }
+}
+
+std::optional<KeyStats> AdaptivePredictiveCache::takeStats(std::string_view key) {
+    std::optional<KeyStats> stats = meta_store.take(key);
+    if (stats) {
+        key_bytes -= stringHeapBytes(key.size());
+    }
+    return stats;
 }
 
-void AdaptivePredictiveCache::removeKey(const std::string& key) {
-    meta_store.erase(key);
+void AdaptivePredictiveCache::restoreStats(std::string_view key, const KeyStats& stats) {
+    KeyStats& s = statsFor(key);
+    s = stats;
+    computeScore(s, getCurrentTime());
 }
 
-bool AdaptivePredictiveCache::contains(const std::string& key) const {
-    return meta_store.count(key) > 0;
+void AdaptivePredictiveCache::loadKey(std::string_view key, KeyStats stats, std::chrono::steady_clock::time_point now) {
+    computeScore(stats, now);
+    if (meta_store.emplace(key, std::move(stats)).second) {
+        key_bytes += stringHeapBytes(key.size());
+    }
+}
+
+bool AdaptivePredictiveCache::contains(std::string_view key) const {
+    return meta_store.find(key) != nullptr;
 }
 
-double AdaptivePredictiveCache::getScore(const std::string& key) {
-    updateScore(key); // Ensure score is up-to-date before returning
-    auto it = meta_store.find(key);
-    if (it != meta_store.end()) {
-        return it->second.score;
+double AdaptivePredictiveCache::getScore(std::string_view key) {
+    KeyStats* s = meta_store.find(key);
+    if (s == nullptr) {
+        return 0.0; // Or some other default/error value
     }
-    return 0.0; // Or some other default/error value
+    computeScore(*s, getCurrentTime()); // Ensure score is up-to-date before returning
+    return s->score;
 }
 
 void AdaptivePredictiveCache::clear() {
     meta_store.clear();
-}
\ No newline at end of file
+    key_bytes = 0;
+    eviction_pool.clear();
+}
@@ -0,0 +1,451 @@
+#include "../include/AppendOnlyFile.h"
+#include "../include/RedisCommandHandler.h"
+#include "../include/RedisDatabase.h"
+#include "../include/RespParser.h"
+
+#include <iostream>
+#include <thread>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+namespace {
+
+// End offset of the last command this thread appended and has not committed yet;
+// 0 when there is nothing to commit. One worker runs one connection's batch at a time,
+// so this is exactly what that batch needs made durable before its replies go out.
+thread_local uint64_t pending_end = 0;
+
+// List/hash/sorted set elements per command when the rewrite rebuilds a key.
+constexpr size_t REWRITE_BATCH = 64;
+
+bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+void appendLength(std::string& out, char prefix, size_t n) {
+    char digits[24];
+    auto res = std::to_chars(digits, digits + sizeof(digits), n);
+    out.push_back(prefix);
+    out.append(digits, res.ptr);
+    out.append("\r\n", 2);
+}
+
+// Encodes one command as a RESP array of bulk strings, the same form clients send.
+void encodeCommand(std::string& out, const std::string_view* args, size_t count) {
+    appendLength(out, '*', count);
+    for (size_t i = 0; i < count; ++i) {
+        appendLength(out, '$', args[i].size());
+        out.append(args[i].data(), args[i].size());
+        out.append("\r\n", 2);
+    }
+}
+
+void encodeCommand(std::string& out, std::initializer_list<std::string_view> args) {
+    encodeCommand(out, args.begin(), args.size());
+}
+
+// Runs in the rewrite child: writes commands rebuilding the child's copy of the keyspace.
+bool writeKeyspace(const std::string& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    const size_t FLUSH_SIZE = 1 << 20;
+    std::string out;
+    out.reserve(FLUSH_SIZE + 64 * 1024);
+    bool ok = true;
+    std::vector<std::string_view> args;
+
+    RedisDatabase::getInstance().forEachUnlocked([&](const std::string& key, const RedisObject& obj) {
+        std::string deadline = obj.hasExpire() ? std::to_string(obj.expire_at_ms) : std::string();
+        char buf[RedisObject::INT_STR_SIZE];
+        switch (obj.type) {
+            case ObjectType::STRING:
+                if (obj.hasExpire()) {
+                    encodeCommand(out, {"SET", key, obj.strView(buf), "PXAT", deadline});
+                } else {
+                    encodeCommand(out, {"SET", key, obj.strView(buf)});
+                }
+                break;
+            case ObjectType::LIST: {
+                args.assign({"RPUSH", key});
+                obj.list().forEach([&](std::string_view item) {
+                    args.push_back(item);
+                    if (args.size() == 2 + REWRITE_BATCH) {
+                        encodeCommand(out, args.data(), args.size());
+                        args.resize(2);
+                    }
+                });
+                if (args.size() > 2) {
+                    encodeCommand(out, args.data(), args.size());
+                }
+                break;
+            }
+            case ObjectType::HASH: {
+                args.assign({"HMSET", key});
+                obj.hashForEach([&](std::string_view field, std::string_view value) {
+                    args.push_back(field);
+                    args.push_back(value);
+                    if (args.size() == 2 + 2 * REWRITE_BATCH) {
+                        encodeCommand(out, args.data(), args.size());
+                        args.resize(2);
+                    }
+                });
+                if (args.size() > 2) {
+                    encodeCommand(out, args.data(), args.size());
+                }
+                break;
+            }
+            case ObjectType::SET: {
+                args.assign({"SADD", key});
+                auto add = [&](std::string_view member) {
+                    args.push_back(member);
+                    if (args.size() == 2 + REWRITE_BATCH) {
+                        encodeCommand(out, args.data(), args.size());
+                        args.resize(2);
+                    }
+                };
+                if (obj.encoding == ObjectEncoding::INTSET) {
+                    char ints[REWRITE_BATCH][RedisObject::INT_STR_SIZE]; // backs the member views in args
+                    obj.intset().forEach([&](int64_t v) {
+                        char* slot = ints[args.size() - 2];
+                        add(std::string_view(slot, std::to_chars(slot, slot + RedisObject::INT_STR_SIZE, v).ptr - slot));
+                    });
+                } else {
+                    obj.set().forEach([&add](const std::string& member, std::monostate) { add(member); });
+                }
+                if (args.size() > 2) {
+                    encodeCommand(out, args.data(), args.size());
+                }
+                break;
+            }
+            case ObjectType::ZSET: {
+                char scores[REWRITE_BATCH][SortedSet::SCORE_STR_SIZE]; // backs the score views in args
+                args.assign({"ZADD", key});
+                obj.zsetForEach([&](std::string_view member, double score) {
+                    args.push_back(SortedSet::formatScore(score, scores[(args.size() - 2) / 2]));
+                    args.push_back(member);
+                    if (args.size() == 2 + 2 * REWRITE_BATCH) {
+                        encodeCommand(out, args.data(), args.size());
+                        args.resize(2);
+                    }
+                });
+                if (args.size() > 2) {
+                    encodeCommand(out, args.data(), args.size());
+                }
+                break;
+            }
+        }
+        if (obj.type != ObjectType::STRING && obj.hasExpire()) {
+            encodeCommand(out, {"PEXPIREAT", key, deadline});
+        }
+        if (out.size() >= FLUSH_SIZE) {
+            ok = writeAll(fd, out.data(), out.size()) && ok;
+            out.clear();
+        }
+    });
+    ok = writeAll(fd, out.data(), out.size()) && ok;
+    ok = (fdatasync(fd) == 0) && ok;
+    return (::close(fd) == 0) && ok;
+}
+
+} // namespace
+
+AppendOnlyFile& AppendOnlyFile::getInstance() {
+    static AppendOnlyFile instance;
+    return instance;
+}
+
+bool AppendOnlyFile::replay(const std::string& filename, RedisCommandHandler& handler) {
+    int in = ::open(filename.c_str(), O_RDWR);
+    if (in < 0) return false;
+
+    // Read in large chunks and execute straight from the read buffer, exactly as
+    // commands arriving on a client connection are.
+    const size_t READ_CHUNK = 1 << 20;
+    std::string buffer;
+    RespParser parser;
+    CommandArgs args;
+    uint64_t buffer_offset = 0; // file offset of buffer[0]
+    uint64_t commands = 0;
+    bool ok = true;
+    while (true) {
+        size_t old_size = buffer.size();
+        buffer.resize(old_size + READ_CHUNK);
+        ssize_t n = ::read(in, &buffer[old_size], READ_CHUNK);
+        buffer.resize(old_size + (n > 0 ? n : 0));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ok = false;
+            break;
+        }
+        RespParser::Result r;
+        while ((r = parser.next(buffer, args)) == RespParser::COMMAND_READY) {
+            handler.processCommand(args);
+            ++commands;
+        }
+        if (r == RespParser::PROTOCOL_ERROR) {
+            std::cerr << "Bad command in " << filename << " near offset " << buffer_offset
+                      << ": " << parser.errorMessage() << "\n";
+            ok = false;
+            break;
+        }
+        size_t before = buffer.size();
+        parser.discardConsumed(buffer);
+        buffer_offset += before - buffer.size();
+        if (n == 0) break; // end of file
+    }
+    if (ok && !buffer.empty()) {
+        // The server died while writing the last command: drop it, like Redis' aof-load-truncated
+        std::cerr << filename << " ends with an incomplete command; truncating " << buffer.size() << " bytes\n";
+        ok = ::ftruncate(in, static_cast<off_t>(buffer_offset)) == 0;
+    }
+    ::close(in);
+    if (ok) {
+        std::cout << "Replayed " << commands << " commands from " << filename << "\n";
+    }
+    return ok;
+}
+
+bool AppendOnlyFile::open(const std::string& name, AofFsync fsync_policy) {
+    int out = ::open(name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (out < 0) return false;
+    struct stat st;
+    uint64_t size = fstat(out, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        filename = name;
+        fd = out;
+        current.current_size = current.base_size = size;
+    }
+    policy.store(fsync_policy);
+    enabled.store(true, std::memory_order_release);
+    std::thread([this] { cronLoop(); }).detach();
+    return true;
+}
+
+void AppendOnlyFile::shutdown() {
+    if (!enabled.exchange(false)) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    committed.wait(lock, [this] { return !leader_active; });
+    if (rewrite_child > 0) {
+        // The process may exit before the reaper gets to run, so drop the half-written
+        // file here; the child's open descriptor keeps it alive until it is killed.
+        kill(rewrite_child, SIGUSR1);
+        std::remove((filename + ".rewrite").c_str());
+    }
+    std::lock_guard<std::mutex> io(io_mutex);
+    bool ok = writeAll(fd, buffer.data(), buffer.size()) && fdatasync(fd) == 0;
+    ::close(fd);
+    fd = -1;
+    buffer.clear();
+    written = synced = appended;
+    committed.notify_all();
+    if (!ok) {
+        std::cerr << "Error flushing " << filename << " on shutdown\n";
+    }
+}
+
+void AppendOnlyFile::append(const CommandArgs& args) {
+    appendEncoded(args.begin(), args.size());
+}
+
+void AppendOnlyFile::append(const std::vector<std::string_view>& args) {
+    appendEncoded(args.data(), args.size());
+}
+
+void AppendOnlyFile::appendEncoded(const std::string_view* args, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t start = buffer.size();
+    encodeCommand(buffer, args, count);
+    size_t len = buffer.size() - start;
+    if (rewrite_child > 0) {
+        rewrite_buffer.append(buffer, start, len);
+    }
+    appended += len;
+    pending_end = appended;
+}
+
+bool AppendOnlyFile::commit() {
+    uint64_t target = pending_end;
+    if (target == 0) return true;
+    pending_end = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    bool sync = policy.load() == AofFsync::ALWAYS;
+    while ((sync ? synced : written) < target) {
+        if (leader_active) {
+            committed.wait(lock); // another worker's commit may cover this batch too
+            continue;
+        }
+        // Lead a group commit: write everything appended so far, for every waiting worker
+        leader_active = true;
+        batch.clear();
+        batch.swap(buffer);
+        uint64_t end = appended;
+        lock.unlock();
+        bool ok;
+        {
+            std::lock_guard<std::mutex> io(io_mutex);
+            ok = writeAll(fd, batch.data(), batch.size());
+            if (ok && sync) ok = fdatasync(fd) == 0;
+        }
+        lock.lock();
+        leader_active = false;
+        // Failed data is not retried; waiters are released and the error is reported
+        written = end;
+        if (sync || !ok) synced = std::max(synced, end);
+        if (ok) current.current_size += batch.size();
+        if (!ok && current.last_write_ok) {
+            std::cerr << "Error writing " << filename << ": " << std::strerror(errno) << "\n";
+        }
+        current.last_write_ok = ok;
+        committed.notify_all();
+    }
+    return current.last_write_ok;
+}
+
+void AppendOnlyFile::cronLoop() {
+    while (isEnabled()) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        uint64_t target;
+        bool rewrite;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            target = synced < written && policy.load() == AofFsync::EVERYSEC ? written : 0;
+            rewrite = rewrite_child < 0 && current.current_size >= AUTO_REWRITE_MIN_SIZE &&
+                      current.current_size >= 2 * current.base_size;
+        }
+        if (target > 0) {
+            bool ok;
+            {
+                std::lock_guard<std::mutex> io(io_mutex);
+                ok = fd >= 0 && fdatasync(fd) == 0;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok) synced = std::max(synced, target);
+        }
+        if (rewrite && isEnabled()) {
+            std::cout << "Starting automatic rewrite of " << filename << "\n";
+            rewriteInBackground();
+        }
+    }
+}
+
+bool AppendOnlyFile::rewriteInBackground() {
+    std::unique_lock<std::shared_mutex> no_writes(gate); // in-flight write commands finish logging first
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isEnabled() || rewrite_child > 0) return false;
+    const std::string tmp = filename + ".rewrite";
+    auto started = std::chrono::steady_clock::now();
+    pid_t pid = RedisDatabase::getInstance().forkSnapshotChild([&tmp] { return writeKeyspace(tmp); });
+    if (pid < 0) {
+        current.last_rewrite_ok = false;
+        return false;
+    }
+    rewrite_child = pid;
+    current.rewrite_in_progress = true;
+    std::thread([this, pid, started, tmp] { reapRewriteChild(pid, started, tmp); }).detach();
+    return true;
+}
+
+void AppendOnlyFile::reapRewriteChild(pid_t pid, std::chrono::steady_clock::time_point started, const std::string& tmp) {
+    // Wait without reaping, as RedisDatabase::reapSaveChild() does: the child stays a
+    // zombie, so its pid cannot be reused, until rewrite_child no longer names it.
+    siginfo_t info{};
+    while (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) < 0 && errno == EINTR) {
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    committed.wait(lock, [this] { return !leader_active; });
+    rewrite_child = -1;
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    bool cancelled = !isEnabled();
+    ok = ok && !cancelled && installRewrite(tmp);
+    if (!ok) {
+        std::remove(tmp.c_str());
+    }
+    std::string().swap(rewrite_buffer);
+    current.rewrite_in_progress = false;
+    if (cancelled) return;
+    current.last_rewrite_ok = ok;
+    current.last_rewrite_duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    if (ok) {
+        std::cout << "Rewrote " << filename << ": " << current.current_size << " bytes in "
+                  << current.last_rewrite_duration_ms << " ms\n";
+    } else {
+        std::cerr << "Background rewrite of " << filename << " failed\n";
+    }
+}
+
+bool AppendOnlyFile::installRewrite(const std::string& tmp) {
+    // Add what was logged while the child was writing, then swap the files. The old
+    // log stays in place, untouched, until the rename succeeds.
+    int out = ::open(tmp.c_str(), O_WRONLY | O_APPEND);
+    if (out < 0) return false;
+    if (!writeAll(out, rewrite_buffer.data(), rewrite_buffer.size()) || fdatasync(out) != 0 ||
+        std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        ::close(out);
+        return false;
+    }
+    struct stat st;
+    uint64_t size = fstat(out, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    {
+        std::lock_guard<std::mutex> io(io_mutex);
+        ::close(fd);
+        fd = out;
+    }
+    // Everything still buffered for the old file is already in the new one: commands
+    // from before the fork through the child's snapshot, later ones via rewrite_buffer.
+    buffer.clear();
+    written = synced = appended;
+    current.current_size = current.base_size = size;
+    committed.notify_all();
+    return true;
+}
+
+const char* AppendOnlyFile::getFsyncPolicy() const {
+    switch (policy.load()) {
+        case AofFsync::ALWAYS:   return "always";
+        case AofFsync::EVERYSEC: return "everysec";
+        case AofFsync::NO:       return "no";
+    }
+    return "everysec";
+}
+
+bool AppendOnlyFile::parseFsyncPolicy(std::string_view name, AofFsync& p) {
+    if (name == "always") {
+        p = AofFsync::ALWAYS;
+    } else if (name == "everysec") {
+        p = AofFsync::EVERYSEC;
+    } else if (name == "no") {
+        p = AofFsync::NO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+AppendOnlyFile::Stats AppendOnlyFile::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats s = current;
+    s.enabled = isEnabled();
+    return s;
+}
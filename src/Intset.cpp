@@ -0,0 +1,223 @@
+#include "../include/Intset.h"
+#include "../include/RedisObject.h" // mallocSize
+#include <limits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+bool fitsNarrow(int64_t v) {
+    return v >= std::numeric_limits<int32_t>::min() && v <= std::numeric_limits<int32_t>::max();
+}
+
+#if defined(__SSE2__)
+// Block comparisons: matches(a, b) has bit k set when a[k] equals any of the WIDTH
+// values at b. Comparing a against every rotation of b covers all pairs.
+template <typename T>
+struct Lanes;
+
+template <>
+struct Lanes<int32_t> {
+    static constexpr size_t WIDTH = 4;
+    static unsigned matches(const int32_t* a, const int32_t* b) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        __m128i m = _mm_cmpeq_epi32(va, vb);
+        m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+        m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+        return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(m)));
+    }
+};
+
+template <>
+struct Lanes<int64_t> {
+    static constexpr size_t WIDTH = 2;
+    // SSE2 has no 64-bit compare: both 32-bit halves must match
+    static __m128i equal(__m128i x, __m128i y) {
+        __m128i halves = _mm_cmpeq_epi32(x, y);
+        return _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+    static unsigned matches(const int64_t* a, const int64_t* b) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        __m128i m = _mm_or_si128(equal(va, vb), equal(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        return static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(m)));
+    }
+};
+#endif
+
+// When one side is this many times smaller, looking its values up in the other by
+// binary search beats walking both.
+constexpr size_t GALLOP_RATIO = 32;
+
+template <typename T>
+size_t intersect(const T* a, size_t na, const T* b, size_t nb, T* out) {
+    if (na > nb) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+    size_t i = 0, j = 0, n = 0;
+    if (na * GALLOP_RATIO < nb) {
+        for (; i < na; ++i) {
+            j = std::lower_bound(b + j, b + nb, a[i]) - b;
+            if (j == nb) break;
+            if (b[j] == a[i]) out[n++] = a[i];
+        }
+        return n;
+    }
+#if defined(__SSE2__)
+    // Advancing the block with the smaller maximum never skips a match: every value
+    // of the other block that could still match is at least as large. Each value of
+    // a matches at most one block of b, so it is written at most once.
+    constexpr size_t W = Lanes<T>::WIDTH;
+    while (i + W <= na && j + W <= nb) {
+        unsigned mask = Lanes<T>::matches(a + i, b + j);
+        for (size_t k = 0; k < W; ++k) { // branch-free: write each lane, keep the matches
+            out[n] = a[i + k];
+            n += mask >> k & 1;
+        }
+        T amax = a[i + W - 1], bmax = b[j + W - 1];
+        if (amax <= bmax) i += W;
+        if (bmax <= amax) j += W;
+    }
+#endif
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            ++i;
+        } else if (b[j] < a[i]) {
+            ++j;
+        } else {
+            out[n++] = a[i];
+            ++i;
+            ++j;
+        }
+    }
+    return n;
+}
+
+template <typename T>
+size_t difference(const T* a, size_t na, const T* b, size_t nb, T* out) {
+    size_t i = 0, j = 0, n = 0;
+    if (na * GALLOP_RATIO < nb) {
+        for (; i < na; ++i) {
+            j = std::lower_bound(b + j, b + nb, a[i]) - b;
+            if (j == nb || b[j] != a[i]) out[n++] = a[i];
+        }
+        return n;
+    }
+    unsigned found = 0; // lanes of the block at a + i seen in b so far
+#if defined(__SSE2__)
+    // A block of a is final once the block of b reaches past its maximum; only then
+    // are its unmatched values written.
+    constexpr size_t W = Lanes<T>::WIDTH;
+    while (i + W <= na && j + W <= nb) {
+        found |= Lanes<T>::matches(a + i, b + j);
+        T amax = a[i + W - 1], bmax = b[j + W - 1];
+        if (amax <= bmax) {
+            for (size_t k = 0; k < W; ++k) { // branch-free, as in intersect()
+                out[n] = a[i + k];
+                n += ~found >> k & 1;
+            }
+            found = 0;
+            i += W;
+        }
+        if (bmax <= amax) j += W;
+    }
+#endif
+    for (size_t start = i; i < na; ++i) {
+        if (i - start < 32 && (found >> (i - start) & 1)) continue;
+        while (j < nb && b[j] < a[i]) ++j;
+        if (j == nb || b[j] != a[i]) out[n++] = a[i];
+    }
+    return n;
+}
+
+template <typename T>
+size_t unite(const T* a, size_t na, const T* b, size_t nb, T* out) {
+    size_t i = 0, j = 0, n = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            out[n++] = a[i++];
+        } else if (b[j] < a[i]) {
+            out[n++] = b[j++];
+        } else {
+            out[n++] = a[i++];
+            ++j;
+        }
+    }
+    n = std::copy(a + i, a + na, out + n) - out;
+    return std::copy(b + j, b + nb, out + n) - out;
+}
+
+} // namespace
+
+bool Intset::contains(int64_t v) const {
+    if (!wide() && !fitsNarrow(v)) return false;
+    return std::visit([v](const auto& vals) {
+        return std::binary_search(vals.begin(), vals.end(), v);
+    }, values);
+}
+
+bool Intset::insert(int64_t v) {
+    if (!wide() && !fitsNarrow(v)) {
+        std::vector<int64_t> widened;
+        widened.reserve(size() + 1);
+        forEach([&widened](int64_t x) { widened.push_back(x); });
+        values = std::move(widened);
+    }
+    return std::visit([v](auto& vals) {
+        using T = typename std::decay_t<decltype(vals)>::value_type;
+        auto it = std::lower_bound(vals.begin(), vals.end(), v);
+        if (it != vals.end() && *it == v) return false;
+        vals.insert(it, static_cast<T>(v));
+        return true;
+    }, values);
+}
+
+bool Intset::erase(int64_t v) {
+    if (!wide() && !fitsNarrow(v)) return false;
+    return std::visit([v](auto& vals) {
+        auto it = std::lower_bound(vals.begin(), vals.end(), v);
+        if (it == vals.end() || *it != v) return false;
+        vals.erase(it);
+        if (vals.capacity() > 2 * vals.size() + 16) {
+            vals.shrink_to_fit();
+        }
+        return true;
+    }, values);
+}
+
+void Intset::assignSorted(const std::vector<int64_t>& sorted) {
+    if (sorted.empty() || (fitsNarrow(sorted.front()) && fitsNarrow(sorted.back()))) {
+        values = std::vector<int32_t>(sorted.begin(), sorted.end());
+    } else {
+        values = sorted;
+    }
+}
+
+size_t Intset::memoryUsage() const {
+    return std::visit([](const auto& vals) {
+        return mallocSize(vals.capacity() * sizeof(vals[0]));
+    }, values);
+}
+
+size_t intersectSorted(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out) {
+    return intersect(a, na, b, nb, out);
+}
+size_t intersectSorted(const int64_t* a, size_t na, const int64_t* b, size_t nb, int64_t* out) {
+    return intersect(a, na, b, nb, out);
+}
+size_t differenceSorted(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out) {
+    return difference(a, na, b, nb, out);
+}
+size_t differenceSorted(const int64_t* a, size_t na, const int64_t* b, size_t nb, int64_t* out) {
+    return difference(a, na, b, nb, out);
+}
+size_t unionSorted(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out) {
+    return unite(a, na, b, nb, out);
+}
+size_t unionSorted(const int64_t* a, size_t na, const int64_t* b, size_t nb, int64_t* out) {
+    return unite(a, na, b, nb, out);
+}
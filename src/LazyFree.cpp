@@ -0,0 +1,36 @@
+#include "../include/LazyFree.h"
+#include <thread>
+
+// Never destroyed: the worker thread may still be running when the process exits.
+LazyFree& LazyFree::getInstance() {
+    static LazyFree* instance = new LazyFree();
+    return *instance;
+}
+
+LazyFree::LazyFree() {
+    std::thread(&LazyFree::run, this).detach();
+}
+
+void LazyFree::enqueue(std::unique_ptr<Job> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    pending.fetch_add(1, std::memory_order_relaxed);
+    ready.notify_one();
+}
+
+void LazyFree::run() {
+    while (true) {
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return !jobs.empty(); });
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job.reset(); // the expensive part, with no lock held
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        freed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
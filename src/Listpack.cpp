@@ -0,0 +1,100 @@
+#include "../include/Listpack.h"
+#include "../include/RedisObject.h" // stringHeapBytes
+
+void Listpack::encode(std::string& out, std::string_view s) {
+    uint64_t len = s.size();
+    while (len >= 0x80) {
+        out.push_back(static_cast<char>((len & 0x7F) | 0x80));
+        len >>= 7;
+    }
+    out.push_back(static_cast<char>(len));
+    out.append(s.data(), s.size());
+}
+
+std::string_view Listpack::decode(const char*& p) {
+    uint64_t len = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t b = static_cast<uint8_t>(*p++);
+        len |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) break;
+    }
+    std::string_view s(p, len);
+    p += len;
+    return s;
+}
+
+size_t Listpack::locate(std::string_view field) const {
+    const char* p = buf.data();
+    for (uint32_t i = 0; i < count; ++i) {
+        const char* pair = p;
+        std::string_view f = decode(p);
+        decode(p); // value
+        if (f == field) return pair - buf.data();
+    }
+    return std::string::npos;
+}
+
+bool Listpack::find(std::string_view field, std::string_view& value) const {
+    size_t pos = locate(field);
+    if (pos == std::string::npos) return false;
+    const char* p = buf.data() + pos;
+    decode(p);
+    value = decode(p);
+    return true;
+}
+
+bool Listpack::set(std::string_view field, std::string_view value) {
+    size_t pos = locate(field);
+    if (pos == std::string::npos) {
+        append(field, value);
+        return true;
+    }
+    // Re-encode just the value, shifting the pairs after it
+    const char* p = buf.data() + pos;
+    decode(p);
+    const char* value_begin = p;
+    decode(p);
+    size_t begin = value_begin - buf.data();
+    size_t old_size = p - value_begin;
+    std::string encoded;
+    encode(encoded, value);
+    buf.replace(begin, old_size, encoded);
+    return false;
+}
+
+void Listpack::append(std::string_view field, std::string_view value) {
+    encode(buf, field);
+    encode(buf, value);
+    ++count;
+}
+
+void Listpack::insert(size_t index, std::string_view field, std::string_view value) {
+    const char* p = buf.data();
+    for (size_t i = 0; i < index; ++i) {
+        decode(p);
+        decode(p);
+    }
+    std::string encoded;
+    encode(encoded, field);
+    encode(encoded, value);
+    buf.insert(p - buf.data(), encoded);
+    ++count;
+}
+
+bool Listpack::erase(std::string_view field) {
+    size_t pos = locate(field);
+    if (pos == std::string::npos) return false;
+    const char* p = buf.data() + pos;
+    decode(p);
+    decode(p);
+    buf.erase(pos, (p - buf.data()) - pos);
+    --count;
+    if (buf.capacity() > 2 * buf.size() + 64) {
+        buf.shrink_to_fit();
+    }
+    return true;
+}
+
+size_t Listpack::memoryUsage() const {
+    return stringHeapBytes(buf);
+}
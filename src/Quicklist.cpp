@@ -0,0 +1,296 @@
+#include "../include/Quicklist.h"
+#include "../include/RedisObject.h" // mallocSize
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+
+size_t varintSize(uint64_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+} // namespace
+
+// ---- element encoding ----
+
+size_t Quicklist::entrySize(size_t len) {
+    size_t front = varintSize(len) + len;
+    return front + varintSize(front);
+}
+
+void Quicklist::encode(char* p, std::string_view value) {
+    char* start = p;
+    uint64_t len = value.size();
+    while (len >= 0x80) {
+        *p++ = static_cast<char>((len & 0x7F) | 0x80);
+        len >>= 7;
+    }
+    *p++ = static_cast<char>(len);
+    std::memcpy(p, value.data(), value.size());
+    p += value.size();
+    // backlen: most significant group first, every byte but that one flagged, so a
+    // reader starting from the last byte knows whether another byte precedes it
+    size_t front = p - start;
+    size_t groups = varintSize(front);
+    for (size_t i = groups; i-- > 0;) {
+        *p++ = static_cast<char>(((front >> (7 * i)) & 0x7F) | (i + 1 < groups ? 0x80 : 0));
+    }
+}
+
+std::string_view Quicklist::decodeForward(const char* p, size_t& entry_size) {
+    uint64_t len = 0;
+    size_t header = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t b = static_cast<uint8_t>(p[header++]);
+        len |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) break;
+    }
+    size_t front = header + len;
+    entry_size = front + varintSize(front);
+    return std::string_view(p + header, len);
+}
+
+std::string_view Quicklist::decodeBackward(const char* end, size_t& entry_size) {
+    size_t front = 0;
+    size_t backlen = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t b = static_cast<uint8_t>(*(end - 1 - backlen++));
+        front |= static_cast<size_t>(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) break;
+    }
+    return decodeForward(end - backlen - front, entry_size);
+}
+
+// ---- nodes ----
+
+Quicklist::Node* Quicklist::insertNode(Node* after) {
+    Node* n = new Node();
+    n->prev = after;
+    n->next = after ? after->next : head;
+    (n->next ? n->next->prev : tail) = n;
+    (after ? after->next : head) = n;
+    bytes += mallocSize(sizeof(Node));
+    ++nodes;
+    return n;
+}
+
+void Quicklist::removeNode(Node* n) {
+    (n->prev ? n->prev->next : head) = n->next;
+    (n->next ? n->next->prev : tail) = n->prev;
+    bytes -= mallocSize(sizeof(Node)) + mallocSize(n->capacity);
+    std::free(n->buf);
+    delete n;
+    --nodes;
+}
+
+void Quicklist::reserve(Node* n, size_t needed) {
+    if (needed <= n->capacity) return;
+    // Double while under NODE_BYTES; a block only passes it to hold one large element
+    size_t capacity = std::max(needed, std::min(std::max(n->capacity * 2, MIN_BLOCK), NODE_BYTES));
+    char* buf = static_cast<char*>(std::realloc(n->buf, capacity));
+    if (buf == nullptr) throw std::bad_alloc();
+    bytes += mallocSize(capacity) - mallocSize(n->capacity);
+    n->buf = buf;
+    n->capacity = capacity;
+}
+
+Quicklist::Node* Quicklist::locate(size_t index, size_t& offset) const {
+    if (index < count / 2) {
+        Node* n = head;
+        while (index >= n->count) {
+            index -= n->count;
+            n = n->next;
+        }
+        offset = index;
+        return n;
+    }
+    size_t from_tail = count - 1 - index;
+    Node* n = tail;
+    while (from_tail >= n->count) {
+        from_tail -= n->count;
+        n = n->prev;
+    }
+    offset = n->count - 1 - from_tail;
+    return n;
+}
+
+char* Quicklist::entryAt(Node* n, size_t offset) {
+    size_t entry_size;
+    if (offset < n->count / 2) {
+        char* p = n->buf;
+        for (size_t i = 0; i < offset; ++i) {
+            decodeForward(p, entry_size);
+            p += entry_size;
+        }
+        return p;
+    }
+    char* end = n->buf + n->used;
+    for (size_t i = n->count; i > offset; --i) {
+        decodeBackward(end, entry_size);
+        end -= entry_size;
+    }
+    return end;
+}
+
+// ---- list operations ----
+
+void Quicklist::pushFront(std::string_view value) {
+    size_t es = entrySize(value.size());
+    Node* n = head;
+    if (n == nullptr || n->used + es > NODE_BYTES) {
+        n = insertNode(nullptr);
+    }
+    reserve(n, n->used + es);
+    std::memmove(n->buf + es, n->buf, n->used);
+    encode(n->buf, value);
+    n->used += es;
+    ++n->count;
+    ++count;
+}
+
+void Quicklist::pushBack(std::string_view value) {
+    size_t es = entrySize(value.size());
+    Node* n = tail;
+    if (n == nullptr || n->used + es > NODE_BYTES) {
+        n = insertNode(tail);
+    }
+    reserve(n, n->used + es);
+    encode(n->buf + n->used, value);
+    n->used += es;
+    ++n->count;
+    ++count;
+}
+
+bool Quicklist::popFront(std::string& value) {
+    if (head == nullptr) return false;
+    Node* n = head;
+    size_t es;
+    value.assign(decodeForward(n->buf, es));
+    std::memmove(n->buf, n->buf + es, n->used - es);
+    n->used -= es;
+    --count;
+    if (--n->count == 0) removeNode(n);
+    return true;
+}
+
+bool Quicklist::popBack(std::string& value) {
+    if (tail == nullptr) return false;
+    Node* n = tail;
+    size_t es;
+    value.assign(decodeBackward(n->buf + n->used, es));
+    n->used -= es;
+    --count;
+    if (--n->count == 0) removeNode(n);
+    return true;
+}
+
+bool Quicklist::at(size_t index, std::string_view& value) const {
+    if (index >= count) return false;
+    size_t offset;
+    Node* n = locate(index, offset);
+    size_t es;
+    value = decodeForward(entryAt(n, offset), es);
+    return true;
+}
+
+bool Quicklist::set(size_t index, std::string_view value) {
+    if (index >= count) return false;
+    size_t offset;
+    Node* n = locate(index, offset);
+    size_t pos = entryAt(n, offset) - n->buf;
+    size_t old_size;
+    decodeForward(n->buf + pos, old_size);
+    size_t new_size = entrySize(value.size());
+    if (new_size > old_size) {
+        reserve(n, n->used - old_size + new_size);
+    }
+    std::memmove(n->buf + pos + new_size, n->buf + pos + old_size, n->used - pos - old_size);
+    encode(n->buf + pos, value);
+    n->used = n->used - old_size + new_size;
+    return true;
+}
+
+size_t Quicklist::removeMatching(std::string_view value, long long limit) {
+    // From the tail means: keep all but the last -limit matches, found by counting first
+    size_t skip = 0;
+    size_t budget = limit > 0 ? static_cast<size_t>(limit) : count;
+    if (limit < 0) {
+        size_t matches = 0;
+        forEach([&](std::string_view v) { matches += (v == value); });
+        size_t wanted = static_cast<size_t>(-(limit + 1)) + 1; // -limit, without overflow
+        skip = matches > wanted ? matches - wanted : 0;
+    }
+    size_t removed = 0;
+    for (Node* n = head; n && removed < budget;) {
+        Node* next = n->next;
+        // Compact the block in place, copying each kept element down over removed ones
+        size_t read = 0, write = 0;
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < n->count; ++i) {
+            size_t es;
+            bool match = decodeForward(n->buf + read, es) == value && removed < budget;
+            if (match && skip > 0) {
+                --skip;
+                match = false;
+            }
+            if (match) {
+                ++removed;
+            } else {
+                if (write != read) std::memmove(n->buf + write, n->buf + read, es);
+                write += es;
+                ++kept;
+            }
+            read += es;
+        }
+        count -= n->count - kept;
+        n->used = write;
+        n->count = kept;
+        if (kept == 0) removeNode(n);
+        n = next;
+    }
+    return removed;
+}
+
+void Quicklist::clear() {
+    while (head) {
+        removeNode(head);
+    }
+    count = 0;
+}
+
+Quicklist::Quicklist(const Quicklist& other) {
+    other.forEach([this](std::string_view v) { pushBack(v); });
+}
+
+Quicklist& Quicklist::operator=(const Quicklist& other) {
+    if (this != &other) {
+        Quicklist copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+Quicklist::Quicklist(Quicklist&& other) noexcept
+    : head(other.head), tail(other.tail), count(other.count), nodes(other.nodes), bytes(other.bytes) {
+    other.head = other.tail = nullptr;
+    other.count = other.nodes = other.bytes = 0;
+}
+
+Quicklist& Quicklist::operator=(Quicklist&& other) noexcept {
+    if (this != &other) {
+        clear();
+        std::swap(head, other.head);
+        std::swap(tail, other.tail);
+        std::swap(count, other.count);
+        std::swap(nodes, other.nodes);
+        std::swap(bytes, other.bytes);
+    }
+    return *this;
+}
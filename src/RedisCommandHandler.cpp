@@ -1,81 +1,172 @@
 #include<iostream>//debug
 #include"../include/RedisCommandHandler.h"
 #include "../include/RedisDatabase.h"
+#include "../include/RespParser.h"
+#include "../include/AppendOnlyFile.h"
+#include "../include/LazyFree.h"
 #include<vector>
 #include<sstream>
 #include<algorithm>
-//RESP parser:
-//*2\r\n$4\r\n\PING\r\n$4\r\nTest\r\n
-//*2->array has 2 elements
-//$4-> next string as 4 characters
-//PING 
-//TEST
-
-std::vector<std::string> parseRespCommand(const std::string &input){
-    std:: vector<std::string>tokens;
-    if(input.empty())return tokens;
-    //if it doesn't start with '*' ,fallback to splitting by whitespace.
-    if(input[0]!='*'){
-        std:: istringstream iss(input);
-        std::string token;
-        while(iss>>token){
-            tokens.push_back(token);
-        }
-        return tokens;
-    }
-    size_t pos=0;
-    //Expect '*' followed by number of elements
-    if(input[pos]!='*')return tokens;
-    pos++;//skip '*'
-    //crlf * carriage Return (\r) , line feed(\n)
-    size_t crlf=input.find("\r\n",pos);
-    if(crlf==std::string::npos) return tokens;
-
-    int numElements = std::stoi(input.substr(pos,crlf-pos));// we will check input the subset is from the position to length
-    pos=crlf+2;//skip 2 characters
-    
-    for(int i=0;i<numElements;i++){
-        if((pos>=input.size()) || input[pos]!='$')break;//format error
-        pos++;//skip'$'
-
-        crlf=input.find("\r\n",pos);
-        if(crlf==std::string::npos)break;
-        int len=std::stoi(input.substr(pos,crlf-pos));
-        pos=crlf+2;
-        if(pos+len>input.size())break;
-        std::string token=input.substr(pos,len);
-        tokens.push_back(token);
-        pos+=len+2;//skip token and crlf
+#include<charconv>
+#include<cctype>
+#include<unordered_map>
+#include<stdexcept>
+#include<fstream>
+#include<cstdio>
+#include<climits>
+#include<unistd.h>
 
+//Parse an integer argument straight from its view; throws like std::stoi so the
+//handlers below keep their try/catch error replies.
+static int toInt(std::string_view s){
+    int value=0;
+    auto res=std::from_chars(s.data(),s.data()+s.size(),value);
+    if(res.ec!=std::errc() || res.ptr!=s.data()+s.size()){
+        throw std::invalid_argument("value is not an integer");
+    }
+    return value;
+}
 
+static long long toLongLong(std::string_view s){
+    long long value=0;
+    auto res=std::from_chars(s.data(),s.data()+s.size(),value);
+    if(res.ec!=std::errc() || res.ptr!=s.data()+s.size()){
+        throw std::invalid_argument("value is not an integer");
     }
-    return tokens;
+    return value;
+}
 
+static bool equalsIgnoreCase(std::string_view a,std::string_view b){
+    if(a.size()!=b.size())return false;
+    for(size_t i=0;i<a.size();i++){
+        if(std::toupper(static_cast<unsigned char>(a[i]))!=std::toupper(static_cast<unsigned char>(b[i])))return false;
+    }
+    return true;
 }
 
 //common commands
-static std::string handlePing(const std::vector<std::string>& tokens,RedisDatabase& db){
+static std::string handlePing(const CommandArgs& tokens,RedisDatabase& db){
     return "+PONG\r\n";
 }
-static std::string handleEcho(const std::vector<std::string>&tokens,RedisDatabase& db){
+static std::string handleEcho(const CommandArgs& tokens,RedisDatabase& db){
     if(tokens.size()<2){
         return "Error: ECHO requires a message\r\n";
     }
-        return "+" + tokens[1]+"\r\n";
+        return "+" + std::string(tokens[1])+"\r\n";
 }
-static std::string handleFlushAll(const std::vector<std::string>&/*tokens*/,RedisDatabase& db){
-    db.flushAll();
+//FLUSHALL [ASYNC|SYNC]: ASYNC empties the keyspace at once and frees the old contents in the background
+static std::string handleFlushAll(const CommandArgs& tokens,RedisDatabase& db){
+    bool async=false;
+    if(tokens.size()==2 && equalsIgnoreCase(tokens[1],"ASYNC")){
+        async=true;
+    }else if(tokens.size()>2 || (tokens.size()==2 && !equalsIgnoreCase(tokens[1],"SYNC"))){
+        return "-Error: syntax error, FLUSHALL [ASYNC|SYNC]\r\n";
+    }
+    db.flushAll(async);
     return "+OK\r\n";
 }
 //key/value operations
-static std::string handleSet(const std::vector<std::string>&tokens,RedisDatabase& db){
+//Turns a relative (ms from now) or absolute (unix ms) expire time into an absolute deadline.
+//Throws std::invalid_argument if it does not fit in a millisecond timestamp.
+//The deadline the running command last computed from a relative time, so the AOF logs
+//exactly the deadline that was applied rather than recomputing it from a later clock.
+//Reset by processCommand() before each handler runs.
+static thread_local long long appliedDeadlineMs=0;
+static long long toDeadlineMs(long long amount,long long unit_ms,bool absolute){
+    if(amount>LLONG_MAX/unit_ms || amount<LLONG_MIN/unit_ms){
+        throw std::invalid_argument("expire time out of range");
+    }
+    long long ms=amount*unit_ms;
+    if(absolute)return ms;
+    long long now=currentTimeMs();
+    if(ms>LLONG_MAX-now){
+        throw std::invalid_argument("expire time out of range");
+    }
+    appliedDeadlineMs=now+ms;
+    return appliedDeadlineMs;
+}
+//append-only file feed
+//Logs a successful write command. Relative TTLs (EXPIRE, PEXPIRE, SET EX/PX) are logged
+//as the absolute deadlines the handler applied, so replaying the log later neither extends
+//nor shifts them. INCRBYFLOAT is
+//logged as a SET of its result (the reply), since float rounding on replay could differ.
+static void feedAppendOnlyFile(AppendOnlyFile& aof,const CommandArgs& tokens,const std::string& reply){
+    bool expire=equalsIgnoreCase(tokens[0],"EXPIRE");
+    if(expire || equalsIgnoreCase(tokens[0],"PEXPIRE")){
+        std::string deadline=std::to_string(appliedDeadlineMs);
+        aof.append({"PEXPIREAT",tokens[1],deadline});
+        return;
+    }
+    if(equalsIgnoreCase(tokens[0],"INCRBYFLOAT")){
+        size_t header=reply.find("\r\n")+2; //reply is "$<len>\r\n<value>\r\n"
+        std::string_view value(reply.data()+header,reply.size()-header-2);
+        aof.append({"SET",tokens[1],value,"KEEPTTL"});
+        return;
+    }
+    if(equalsIgnoreCase(tokens[0],"SET")){
+        std::vector<std::string_view> args(tokens.begin(),tokens.end());
+        std::string deadline;
+        for(size_t i=3;i+1<args.size();i++){
+            if(equalsIgnoreCase(args[i],"EX") || equalsIgnoreCase(args[i],"PX")){
+                deadline=std::to_string(appliedDeadlineMs);
+                args[i]="PXAT";
+                args[i+1]=deadline;
+                break;
+            }
+        }
+        aof.append(args);
+        return;
+    }
+    aof.append(tokens);
+}
+//Evictions are logged as DELs so a replayed log does not bring the keys back.
+static void propagateEvictions(AppendOnlyFile& aof,const std::vector<std::string>& keys){
+    for(const std::string& key:keys){
+        aof.append({"DEL",key});
+    }
+}
+
+//SET key value [NX|XX] [EX seconds|PX milliseconds|EXAT unix-seconds|PXAT unix-milliseconds|KEEPTTL]
+static std::string handleSet(const CommandArgs& tokens,RedisDatabase& db){
     if(tokens.size()<3){
         return "-Error: SET requires key and value\r\n";
     }
-    db.set(tokens[1],tokens[2]);
+    int flags=0;
+    long long deadline_ms=0;
+    bool has_expire=false;
+    for(size_t i=3;i<tokens.size();i++){
+        std::string_view opt=tokens[i];
+        if(equalsIgnoreCase(opt,"NX") && !(flags&SET_XX)){
+            flags|=SET_NX;
+        }else if(equalsIgnoreCase(opt,"XX") && !(flags&SET_NX)){
+            flags|=SET_XX;
+        }else if(equalsIgnoreCase(opt,"KEEPTTL") && !has_expire){
+            flags|=SET_KEEPTTL;
+        }else if((equalsIgnoreCase(opt,"EX") || equalsIgnoreCase(opt,"PX") ||
+                  equalsIgnoreCase(opt,"EXAT") || equalsIgnoreCase(opt,"PXAT"))
+                 && !has_expire && !(flags&SET_KEEPTTL) && i+1<tokens.size()){
+            bool seconds=std::toupper(static_cast<unsigned char>(opt[0]))=='E';
+            bool absolute=opt.size()==4;
+            try{
+                long long amount=toLongLong(tokens[++i]);
+                if(amount<=0){
+                    return "-Error: invalid expire time in 'set' command\r\n";
+                }
+                deadline_ms=toDeadlineMs(amount,seconds?1000:1,absolute);
+            }catch(const std::invalid_argument&){
+                return "-Error: invalid expire time in 'set' command\r\n";
+            }
+            has_expire=true;
+        }else{
+            return "-Error: syntax error\r\n";
+        }
+    }
+    if(!db.set(tokens[1],tokens[2],deadline_ms,flags)){
+        return "$-1\r\n"; //NX/XX condition not met
+    }
     return "+OK\r\n";
 }
-static std::string handleGet(const std::vector<std::string>& tokens,RedisDatabase & db){
+static std::string handleGet(const CommandArgs& tokens,RedisDatabase & db){
     if(tokens.size()<2){
         return "-Error: GET requires key\r\n";
     }
@@ -85,8 +176,82 @@ static std::string handleGet(const std::vector<std::string>& tokens,RedisDatabas
     else
         return "$-1\r\n";
 }
-static std::string handleKeys(const std::vector<std::string>&tokens,RedisDatabase &db){
-   auto allKeys=db.keys();
+//Counters and substrings: each runs atomically in the database, so concurrent
+//clients never lose an update the way GET + SET from the client can.
+static std::string integerReply(long long n){
+    return ":"+std::to_string(n)+"\r\n";
+}
+static std::string bulkReply(std::string_view s){
+    std::string reply="$"+std::to_string(s.size())+"\r\n";
+    reply.append(s.data(),s.size());
+    reply+="\r\n";
+    return reply;
+}
+static std::string handleIncr(const CommandArgs& tokens,RedisDatabase& db){
+    return integerReply(db.incrBy(tokens[1],1));
+}
+static std::string handleDecr(const CommandArgs& tokens,RedisDatabase& db){
+    return integerReply(db.incrBy(tokens[1],-1));
+}
+static std::string handleIncrby(const CommandArgs& tokens,RedisDatabase& db){
+    long long delta;
+    try{
+        delta=toLongLong(tokens[2]);
+    }catch(const std::invalid_argument&){
+        return "-Error: value is not an integer or out of range\r\n";
+    }
+    return integerReply(db.incrBy(tokens[1],delta));
+}
+static std::string handleDecrby(const CommandArgs& tokens,RedisDatabase& db){
+    long long delta;
+    try{
+        delta=toLongLong(tokens[2]);
+    }catch(const std::invalid_argument&){
+        return "-Error: value is not an integer or out of range\r\n";
+    }
+    if(delta==LLONG_MIN){
+        return "-Error: decrement would overflow\r\n";
+    }
+    return integerReply(db.incrBy(tokens[1],-delta));
+}
+static std::string handleIncrbyfloat(const CommandArgs& tokens,RedisDatabase& db){
+    long double delta;
+    if(!RedisObject::parseLongDouble(tokens[2],delta)){
+        return "-Error: value is not a valid float\r\n";
+    }
+    return bulkReply(db.incrByFloat(tokens[1],delta));
+}
+static std::string handleAppend(const CommandArgs& tokens,RedisDatabase& db){
+    return integerReply(db.append(tokens[1],tokens[2]));
+}
+static std::string handleStrlen(const CommandArgs& tokens,RedisDatabase& db){
+    return integerReply(db.strLen(tokens[1]));
+}
+static std::string handleGetrange(const CommandArgs& tokens,RedisDatabase& db){
+    try{
+        return bulkReply(db.getRange(tokens[1],toLongLong(tokens[2]),toLongLong(tokens[3])));
+    }catch(const std::invalid_argument&){
+        return "-Error: value is not an integer or out of range\r\n";
+    }
+}
+static std::string handleSetrange(const CommandArgs& tokens,RedisDatabase& db){
+    long long offset;
+    try{
+        offset=toLongLong(tokens[2]);
+    }catch(const std::invalid_argument&){
+        return "-Error: value is not an integer or out of range\r\n";
+    }
+    if(offset<0){
+        return "-Error: offset is out of range\r\n";
+    }
+    return integerReply(db.setRange(tokens[1],static_cast<size_t>(offset),tokens[3]));
+}
+//KEYS [pattern]: without a pattern, every key
+static std::string handleKeys(const CommandArgs& tokens,RedisDatabase &db){
+   if(tokens.size()>2){
+        return "-Error: wrong number of arguments for 'KEYS' command\r\n";
+   }
+   auto allKeys=db.keys(tokens.size()==2?tokens[1]:std::string_view("*"));
    std::ostringstream oss;
    oss<< "*"<<allKeys.size()<<"\r\n";
    for(const auto& key:allKeys){
@@ -94,34 +259,194 @@ static std::string handleKeys(const std::vector<std::string>&tokens,RedisDatabas
     }
     return oss.str();
 }
-static std::string handleType(const std::vector<std::string>&tokens,RedisDatabase & db){
+//SCAN cursor [MATCH pattern] [COUNT count] [TYPE type] / HSCAN|SSCAN key cursor [MATCH pattern] [COUNT count]
+struct ScanOptions{
+    uint64_t cursor=0;
+    std::string_view pattern="*";
+    size_t count=10;
+    std::optional<ObjectType> type;
+};
+//Parses the cursor at tokens[first] and the options after it; returns an error reply, or "" on success.
+static std::string parseScanOptions(const CommandArgs& tokens,size_t first,bool allowType,ScanOptions& options){
+    auto res=std::from_chars(tokens[first].data(),tokens[first].data()+tokens[first].size(),options.cursor);
+    if(res.ec!=std::errc() || res.ptr!=tokens[first].data()+tokens[first].size()){
+        return "-Error: invalid cursor\r\n";
+    }
+    for(size_t i=first+1;i<tokens.size();i+=2){
+        if(i+1>=tokens.size()){
+            return "-Error: syntax error\r\n";
+        }
+        if(equalsIgnoreCase(tokens[i],"MATCH")){
+            options.pattern=tokens[i+1];
+        }else if(equalsIgnoreCase(tokens[i],"COUNT")){
+            long long count;
+            try{
+                count=toLongLong(tokens[i+1]);
+            }catch(const std::invalid_argument&){
+                return "-Error: value is not an integer or out of range\r\n";
+            }
+            if(count<1){
+                return "-Error: syntax error\r\n";
+            }
+            options.count=static_cast<size_t>(count);
+        }else if(allowType && equalsIgnoreCase(tokens[i],"TYPE")){
+            if(equalsIgnoreCase(tokens[i+1],"string"))options.type=ObjectType::STRING;
+            else if(equalsIgnoreCase(tokens[i+1],"list"))options.type=ObjectType::LIST;
+            else if(equalsIgnoreCase(tokens[i+1],"hash"))options.type=ObjectType::HASH;
+            else if(equalsIgnoreCase(tokens[i+1],"zset"))options.type=ObjectType::ZSET;
+            else if(equalsIgnoreCase(tokens[i+1],"set"))options.type=ObjectType::SET;
+            else return "-Error: unknown type name '"+std::string(tokens[i+1])+"'\r\n";
+        }else{
+            return "-Error: syntax error\r\n";
+        }
+    }
+    return "";
+}
+static std::string scanReply(uint64_t cursor,const std::vector<std::string_view>& elements){
+    std::string next=std::to_string(cursor);
+    std::string reply="*2\r\n$"+std::to_string(next.size())+"\r\n"+next+"\r\n*"+std::to_string(elements.size())+"\r\n";
+    for(std::string_view element:elements){
+        reply+='$';
+        reply+=std::to_string(element.size());
+        reply+="\r\n";
+        reply.append(element.data(),element.size());
+        reply+="\r\n";
+    }
+    return reply;
+}
+static std::string handleScan(const CommandArgs& tokens,RedisDatabase& db){
+    ScanOptions options;
+    std::string error=parseScanOptions(tokens,1,true,options);
+    if(!error.empty())return error;
+    std::vector<std::string> keys;
+    uint64_t cursor=db.scan(options.cursor,options.count,options.pattern,options.type,keys);
+    return scanReply(cursor,std::vector<std::string_view>(keys.begin(),keys.end()));
+}
+static std::string handleHscan(const CommandArgs& tokens,RedisDatabase& db){
+    ScanOptions options;
+    std::string error=parseScanOptions(tokens,2,false,options);
+    if(!error.empty())return error;
+    std::vector<std::pair<std::string,std::string>> fields;
+    uint64_t cursor=db.hscan(tokens[1],options.cursor,options.count,options.pattern,fields);
+    std::vector<std::string_view> elements;
+    elements.reserve(fields.size()*2);
+    for(const auto& field:fields){
+        elements.push_back(field.first);
+        elements.push_back(field.second);
+    }
+    return scanReply(cursor,elements);
+}
+static std::string handleSscan(const CommandArgs& tokens,RedisDatabase& db){
+    ScanOptions options;
+    std::string error=parseScanOptions(tokens,2,false,options);
+    if(!error.empty())return error;
+    std::vector<std::string> members;
+    uint64_t cursor=db.sscan(tokens[1],options.cursor,options.count,options.pattern,members);
+    return scanReply(cursor,std::vector<std::string_view>(members.begin(),members.end()));
+}
+static std::string handleType(const CommandArgs& tokens,RedisDatabase & db){
     if(tokens.size()<2){
         return "-Error:TYPE requires key\r\n";
     }
     return "+" + db.type(tokens[1])+"\r\n";
 }
-static std::string handleDel(const std::vector<std::string>&tokens,RedisDatabase& db){
-    if(tokens.size()<2){
-        return "-Error:DEL requires key\r\n";
+//Multi-key commands: the database locks each shard once for the whole batch, and the
+//reply is encoded into a single buffer sized up front.
+static std::vector<std::string_view> keyArgs(const CommandArgs& tokens){
+    return std::vector<std::string_view>(tokens.begin()+1,tokens.end());
+}
+static std::vector<std::pair<std::string_view,std::string_view>> keyValueArgs(const CommandArgs& tokens){
+    std::vector<std::pair<std::string_view,std::string_view>>keyValues;
+    keyValues.reserve((tokens.size()-1)/2);
+    for(size_t i=1;i+1<tokens.size();i+=2){
+        keyValues.emplace_back(tokens[i],tokens[i+1]);
     }
-    bool res=db.del(tokens[1]);
-    return ":" + std::to_string(res?1:0)+"\r\n";
+    return keyValues;
 }
-static std::string handleExpire(const std::vector<std::string>&tokens,RedisDatabase & db){
-    if(tokens.size()<3){
-        return "-Error: Expire requires key and time in seconds\r\n";
+static std::string deleteKeys(const CommandArgs& tokens,RedisDatabase& db,bool lazy){
+    if(tokens.size()==2){
+        return integerReply(db.del(tokens[1],lazy)?1:0);
     }
+    return integerReply(static_cast<long long>(db.del(keyArgs(tokens),lazy)));
+}
+static std::string handleDel(const CommandArgs& tokens,RedisDatabase& db){
+    return deleteKeys(tokens,db,db.getLazyfreeLazyUserDel());
+}
+//UNLINK: like DEL, but large values are freed by the lazy-free thread
+static std::string handleUnlink(const CommandArgs& tokens,RedisDatabase& db){
+    return deleteKeys(tokens,db,true);
+}
+static std::string handleExists(const CommandArgs& tokens,RedisDatabase& db){
+    return integerReply(static_cast<long long>(db.exists(keyArgs(tokens))));
+}
+static std::string handleMget(const CommandArgs& tokens,RedisDatabase& db){
+    auto values=db.mget(keyArgs(tokens));
+    size_t bytes=16;
+    for(const auto& value:values){
+        bytes+=value?value->size()+16:5;
+    }
+    std::string reply;
+    reply.reserve(bytes);
+    reply+="*"+std::to_string(values.size())+"\r\n";
+    for(const auto& value:values){
+        if(!value){
+            reply+="$-1\r\n";
+            continue;
+        }
+        reply+='$';
+        reply+=std::to_string(value->size());
+        reply+="\r\n";
+        reply+=*value;
+        reply+="\r\n";
+    }
+    return reply;
+}
+static std::string handleMset(const CommandArgs& tokens,RedisDatabase& db){
+    if(tokens.size()%2==0){
+        return "-Error: wrong number of arguments for 'MSET' command\r\n";
+    }
+    db.mset(keyValueArgs(tokens));
+    return "+OK\r\n";
+}
+static std::string handleMsetnx(const CommandArgs& tokens,RedisDatabase& db){
+    if(tokens.size()%2==0){
+        return "-Error: wrong number of arguments for 'MSETNX' command\r\n";
+    }
+    return db.msetnx(keyValueArgs(tokens))?":1\r\n":":0\r\n";
+}
+//EXPIRE/PEXPIRE/EXPIREAT/PEXPIREAT: :1 if the TTL was set, :0 if the key does not exist
+static std::string expireGeneric(const CommandArgs& tokens,RedisDatabase& db,long long unit_ms,bool absolute){
     try{
-        int seconds=std::stoi(tokens[2]);
-        if(db.expire(tokens[1],seconds))
-            return "+OK\r\n";
-        else 
-            return "-Error: Keuy not found\r\n";
-    }catch(const std::exception&){
+        long long deadline_ms=toDeadlineMs(toLongLong(tokens[2]),unit_ms,absolute);
+        return db.expireAt(tokens[1],deadline_ms)?":1\r\n":":0\r\n";
+    }catch(const std::invalid_argument&){
         return "-Error:Invalid expiration time\r\n";
     }
 }
-static std::string handleRename(const std::vector<std::string>&tokens,RedisDatabase&db){
+static std::string handleExpire(const CommandArgs& tokens,RedisDatabase & db){
+    return expireGeneric(tokens,db,1000,false);
+}
+static std::string handlePexpire(const CommandArgs& tokens,RedisDatabase & db){
+    return expireGeneric(tokens,db,1,false);
+}
+static std::string handleExpireat(const CommandArgs& tokens,RedisDatabase & db){
+    return expireGeneric(tokens,db,1000,true);
+}
+static std::string handlePexpireat(const CommandArgs& tokens,RedisDatabase & db){
+    return expireGeneric(tokens,db,1,true);
+}
+static std::string handlePttl(const CommandArgs& tokens,RedisDatabase & db){
+    return ":"+std::to_string(db.pttl(tokens[1]))+"\r\n";
+}
+static std::string handleTtl(const CommandArgs& tokens,RedisDatabase & db){
+    long long ms=db.pttl(tokens[1]);
+    if(ms<0)return ":"+std::to_string(ms)+"\r\n"; //-1 no TTL, -2 no key
+    return ":"+std::to_string((ms+500)/1000)+"\r\n"; //rounded like Redis
+}
+static std::string handlePersist(const CommandArgs& tokens,RedisDatabase & db){
+    return db.persist(tokens[1])?":1\r\n":":0\r\n";
+}
+static std::string handleRename(const CommandArgs& tokens,RedisDatabase&db){
     if(tokens.size()<3){
         return "-Error:Rename requires old key and new key\r\n";
     }
@@ -132,7 +457,7 @@ static std::string handleRename(const std::vector<std::string>&tokens,RedisDatab
 }
 
 //List operations
-static std::string handleLget(const std::vector<std::string>&tokens,RedisDatabase& db){
+static std::string handleLget(const CommandArgs& tokens,RedisDatabase& db){
     if(tokens.size()<2){
         return "-Error: LGET requires key\r\n";
     }
@@ -142,20 +467,17 @@ static std::string handleLget(const std::vector<std::string>&tokens,RedisDatabas
     oss<<"*"<<elems.size()<<"\r\n";
     for(const auto& e:elems){
         oss<<"$"<<e.size()<<"\r\n"<<e<<"\r\n";
-        
-        oss<<"$-1\r\n";
-        
     }
     return oss.str();
 }
-static std::string handleLlen(const std::vector<std::string>&tokens,RedisDatabase& db){
+static std::string handleLlen(const CommandArgs& tokens,RedisDatabase& db){
     if(tokens.size()<2){
         return "-Error: LLEN requires key\r\n";
     }
     ssize_t len=db.llen(tokens[1]);
     return ":"+ std::to_string(len)+"\r\n";
 }
-static std::string handleLpush(const std::vector<std::string>&tokens,RedisDatabase& db){
+static std::string handleLpush(const CommandArgs& tokens,RedisDatabase& db){
      if(tokens.size()<3){
         return "-Error: LPUSH requires key and value\r\n";
     }
@@ -166,7 +488,7 @@ static std::string handleLpush(const std::vector<std::string>&tokens,RedisDataba
     ssize_t len=db.llen(tokens[1]);
     return ":"+std::to_string(len)+"\r\n";
 }
-static std::string handleRpush(const std::vector<std::string>&tokens,RedisDatabase& db){
+static std::string handleRpush(const CommandArgs& tokens,RedisDatabase& db){
      if(tokens.size()<2){
         return "-Error: RPUSH requires key and value\r\n";
     }
@@ -177,82 +499,85 @@ static std::string handleRpush(const std::vector<std::string>&tokens,RedisDataba
     ssize_t len=db.llen(tokens[1]);
     return ":"+std::to_string(len)+"\r\n";
 }
-static std::string handleLpop(const std::vector<std::string>&tokens,RedisDatabase& db){
+static std::string handleLpop(const CommandArgs& tokens,RedisDatabase& db){
      if(tokens.size()<2){
         return "-Error: LPOP requires key \r\n";
     }
     std::string val;
     if(db.lpop(tokens[1],val)){
-        return "$"+std::to_string(val.size())+"\r\n";
+        return "$"+std::to_string(val.size())+"\r\n"+val+"\r\n";
     }
     return "$-1\r\n";
-    
 }
-static std::string handleRpop(const std::vector<std::string>&tokens,RedisDatabase& db){
+static std::string handleRpop(const CommandArgs& tokens,RedisDatabase& db){
     if(tokens.size()<2){
         return "-Error: RPOP requires key \r\n";
     }
     std::string val;
-    if(db.lpop(tokens[1],val)){
+    if(db.rpop(tokens[1],val)){
         return "$"+std::to_string(val.size())+"\r\n"+val+"\r\n";
     }
     return "$-1\r\n";
 }
-static std::string handleLrem(const std::vector<std::string>&tokens,RedisDatabase& db){
+static std::string handleLrem(const CommandArgs& tokens,RedisDatabase& db){
      if(tokens.size()<4){
         return "-Error: LREM requires key, count and value\r\n";
     }
     try{
-        int count =std::stoi(tokens[2]);
-        std::string value=tokens[3];
-        int removed=db.lrem(tokens[1],count,value);
+        int count =toInt(tokens[2]);
+        int removed=db.lrem(tokens[1],count,tokens[3]);
         return ":" +std::to_string(removed)+"\r\n";
-    }catch(const std::exception&){
+    }catch(const std::invalid_argument&){
         return "-Error: Invalid count\r\n";
     }
 
 }
-static std::string handleLindex(const std::vector<std::string>&tokens,RedisDatabase& db){
+static std::string handleLindex(const CommandArgs& tokens,RedisDatabase& db){
     if(tokens.size()<3){
         return "-Error : LINDEX requires key and index\r\n";
     }
      try{
-        int index=std::stoi(tokens[2]);
+        int index=toInt(tokens[2]);
         std::string value;
         if(db.lindex(tokens[1],index,value)){
             return "$"+std::to_string(value.size())+"\r\n"+value+"\r\n";
         }else{
             return "$-1\r\n";//error return -1 with newline
         }
-    }catch(const std::exception&){
+    }catch(const std::invalid_argument&){
         return "-Error: Invalid count\r\n";
     }
 }
-static std::string handleLset(const std::vector<std::string>&tokens,RedisDatabase& db){
+static std::string handleLset(const CommandArgs& tokens,RedisDatabase& db){
     if(tokens.size()<4){
         return "-Error: LSET requires key , index and value\r\n";
     }
     try{
-        int index = std::stoi(tokens[2]);
+        int index = toInt(tokens[2]);
         if(db.lset(tokens[1],index,tokens[3]))
             return "+OK\r\n";
         else 
             return "-Error: Index out of range\r\n";
-    }catch(const std::exception&){
+    }catch(const std::invalid_argument&){
         return "-Error:Invalid index\r\n";
     }
 }
 
 //Hash operations
-static std::string handleHset(const std::vector<std::string>&tokens,RedisDatabase& db){
-    if(tokens.size()<4){
+//HSET key field value [field value ...]: replies with the number of fields added
+static std::string handleHset(const CommandArgs& tokens,RedisDatabase& db){
+    if(tokens.size()<4 || (tokens.size()%2)==1){
         return "-Error:HSET requires key,field and value \r\n";
     }
-    db.hset(tokens[1],tokens[2],tokens[3]);
-    return ":1\r\n";
+    std::vector<std::pair<std::string_view,std::string_view>>fieldValues;
+    fieldValues.reserve((tokens.size()-2)/2);
+    for(size_t i=2;i<tokens.size();i+=2){
+        fieldValues.emplace_back(tokens[i],tokens[i+1]);
+    }
+    return integerReply(static_cast<long long>(db.hset(tokens[1],fieldValues)));
 }
 
-static std::string handleHget(const std:: vector<std::string>&tokens,RedisDatabase&db){
+static std::string handleHget(const CommandArgs& tokens,RedisDatabase&db){
     if(tokens.size()<3){
         return "-Error:HGET requires key and field\r\n";
     }
@@ -262,7 +587,7 @@ static std::string handleHget(const std:: vector<std::string>&tokens,RedisDataba
     return "$-1\r\n";
 }
 
-static std::string handleHexists(const std:: vector<std::string>&tokens,RedisDatabase&db){
+static std::string handleHexists(const CommandArgs& tokens,RedisDatabase&db){
     if(tokens.size()<3){
         return "-Error:HEXISTS requires key and field \r\n";
     }
@@ -270,15 +595,15 @@ static std::string handleHexists(const std:: vector<std::string>&tokens,RedisDat
     return ":" +std::to_string(exists?1:0) + "\r\n";
 }
 
-static std::string handleHdel(const std:: vector<std::string>&tokens,RedisDatabase&db){
+static std::string handleHdel(const CommandArgs& tokens,RedisDatabase&db){
     if(tokens.size()<3){
         return "-Error:HDEL requires key and field\r\n";
     }
-    bool resolved=db.hdel(tokens[1],tokens[2]);
-    return ":" + std::to_string(resolved?1:0)+"\r\n";
+    std::vector<std::string_view> fields(tokens.begin()+2,tokens.end());
+    return integerReply(static_cast<long long>(db.hdel(tokens[1],fields)));
 }
 
-static std::string handleHgetall(const std:: vector<std::string>&tokens,RedisDatabase&db){
+static std::string handleHgetall(const CommandArgs& tokens,RedisDatabase&db){
     if(tokens.size()<2){
         return "-Error:HGETALL requires key\r\n";
     }
@@ -292,7 +617,7 @@ static std::string handleHgetall(const std:: vector<std::string>&tokens,RedisDat
     return oss.str();
 }
 
-static std::string handleHkeys(const std:: vector<std::string>&tokens,RedisDatabase&db){
+static std::string handleHkeys(const CommandArgs& tokens,RedisDatabase&db){
     if(tokens.size()<2){
         return "-Error:HKEYS requires key\r\n";
     }
@@ -305,7 +630,7 @@ static std::string handleHkeys(const std:: vector<std::string>&tokens,RedisDatab
     return oss.str();
 }
 
-static std::string handleHvals(const std:: vector<std::string>&tokens,RedisDatabase&db){
+static std::string handleHvals(const CommandArgs& tokens,RedisDatabase&db){
     if(tokens.size()<2){
         return "-Error:HVALS requires key\r\n";
     }
@@ -317,18 +642,19 @@ static std::string handleHvals(const std:: vector<std::string>&tokens,RedisDatab
     }
     return oss.str();
 }
-static std::string handleHlen(const std:: vector<std::string>&tokens,RedisDatabase&db){
+static std::string handleHlen(const CommandArgs& tokens,RedisDatabase&db){
     if(tokens.size()<2){
         return "-Error:HLEN requires key\r\n";
     }
     ssize_t len=db.hlen(tokens[1]);
     return ":" + std::to_string(len)+"\r\n"; 
 }
-static std::string handleHmset(const std:: vector<std::string>&tokens,RedisDatabase&db){
+static std::string handleHmset(const CommandArgs& tokens,RedisDatabase&db){
     if(tokens.size()<4 || (tokens.size()%2)==1){
         return "-Error:HMSET requires key followed  by value pairs\r\n";
     }
-    std::vector<std::pair<std::string,std::string>>fieldValues;
+    std::vector<std::pair<std::string_view,std::string_view>>fieldValues;
+    fieldValues.reserve((tokens.size()-2)/2);
     for(size_t i=2;i<tokens.size();i+=2){
         fieldValues.emplace_back(tokens[i],tokens[i+1]);
     }
@@ -336,112 +662,677 @@ static std::string handleHmset(const std:: vector<std::string>&tokens,RedisDatab
     return "+OK\r\n";
 }
 
-RedisCommandHandler::RedisCommandHandler(){}
-
-std::string RedisCommandHandler::processCommand(const std::string& commandLine){
-    //use RESP protocol
-    auto tokens=parseRespCommand(commandLine);
-    if(tokens.empty())return "-Error:Empty command\r\n";
-
-    // std::cout<<commandLine<<"\n";// Hello world -> *2 $5 Hello $5 world Hello world 
-
-    // for(auto& t:tokens){
-    //     std::cout<<t<<"\n";
-        
-    // }only for debug
-    std::string cmd=tokens[0];
-    std:: transform(cmd.begin(),cmd.end(),cmd.begin(),::toupper);
-    RedisDatabase& db = RedisDatabase::getInstance();
-
-
-    //connect to database
-    //check commands
-    //Common commands
-    if(cmd=="PING"){
-        return handlePing(tokens,db);
-    }else if(cmd=="ECHO"){
-        return handleEcho(tokens,db);
-    }
-    else if (cmd=="FLUSHALL"){
-        return handleFlushAll(tokens,db);
-    }    
-        //Key/Value Operations
+//Sorted set operations
+static std::string scoreReply(double score){
+    char buf[SortedSet::SCORE_STR_SIZE];
+    return bulkReply(SortedSet::formatScore(score,buf));
+}
+//Array of the members, each followed by its score when withScores
+static std::string zsetReply(const std::vector<std::pair<std::string,double>>& members,bool withScores){
+    std::string reply="*"+std::to_string(members.size()*(withScores?2:1))+"\r\n";
+    char buf[SortedSet::SCORE_STR_SIZE];
+    for(const auto& [member,score]:members){
+        reply+=bulkReply(member);
+        if(withScores)reply+=bulkReply(SortedSet::formatScore(score,buf));
+    }
+    return reply;
+}
+//A ZRANGEBYSCORE/ZCOUNT bound: a score, "-inf"/"+inf", or either prefixed with '(' to exclude it
+static bool parseScoreBound(std::string_view text,double& score,bool& exclusive){
+    exclusive=!text.empty() && text[0]=='(';
+    if(exclusive)text.remove_prefix(1);
+    return SortedSet::parseScore(text,score);
+}
+//ZADD key [NX|XX] [GT|LT] [CH] [INCR] score member [score member ...]
+static std::string handleZadd(const CommandArgs& tokens,RedisDatabase& db){
+    int flags=0;
+    bool ch=false,incr=false;
+    size_t i=2;
+    for(;i<tokens.size();i++){
+        if(equalsIgnoreCase(tokens[i],"NX"))flags|=ZADD_NX;
+        else if(equalsIgnoreCase(tokens[i],"XX"))flags|=ZADD_XX;
+        else if(equalsIgnoreCase(tokens[i],"GT"))flags|=ZADD_GT;
+        else if(equalsIgnoreCase(tokens[i],"LT"))flags|=ZADD_LT;
+        else if(equalsIgnoreCase(tokens[i],"CH"))ch=true;
+        else if(equalsIgnoreCase(tokens[i],"INCR"))incr=true;
+        else break;
+    }
+    size_t args=tokens.size()-i;
+    if(args==0 || args%2!=0){
+        return "-Error: syntax error\r\n";
+    }
+    if((flags&ZADD_NX) && (flags&ZADD_XX)){
+        return "-Error: XX and NX options at the same time are not compatible\r\n";
+    }
+    if(((flags&ZADD_GT) && (flags&ZADD_LT)) || ((flags&(ZADD_GT|ZADD_LT)) && (flags&ZADD_NX))){
+        return "-Error: GT, LT, and/or NX options at the same time are not compatible\r\n";
+    }
+    if(incr && args!=2){
+        return "-Error: INCR option supports a single increment-element pair\r\n";
+    }
+    std::vector<std::pair<double,std::string_view>> members;
+    members.reserve(args/2);
+    for(;i<tokens.size();i+=2){
+        double score;
+        if(!SortedSet::parseScore(tokens[i],score)){
+            return "-Error: value is not a valid float\r\n";
+        }
+        members.emplace_back(score,tokens[i+1]);
+    }
+    if(incr){
+        double score;
+        if(!db.zincrBy(tokens[1],members[0].second,members[0].first,flags,score)){
+            return "$-1\r\n";
+        }
+        return scoreReply(score);
+    }
+    size_t updated=0;
+    size_t added=db.zadd(tokens[1],members,flags,updated);
+    return integerReply(static_cast<long long>(ch?added+updated:added));
+}
+static std::string handleZincrby(const CommandArgs& tokens,RedisDatabase& db){
+    double delta;
+    if(!SortedSet::parseScore(tokens[2],delta)){
+        return "-Error: value is not a valid float\r\n";
+    }
+    double score;
+    db.zincrBy(tokens[1],tokens[3],delta,0,score);
+    return scoreReply(score);
+}
+static std::string handleZscore(const CommandArgs& tokens,RedisDatabase& db){
+    double score;
+    if(!db.zscore(tokens[1],tokens[2],score)){
+        return "$-1\r\n";
+    }
+    return scoreReply(score);
+}
+static std::string handleZrem(const CommandArgs& tokens,RedisDatabase& db){
+    std::vector<std::string_view> members(tokens.begin()+2,tokens.end());
+    return integerReply(static_cast<long long>(db.zrem(tokens[1],members)));
+}
+static std::string handleZcard(const CommandArgs& tokens,RedisDatabase& db){
+    return integerReply(static_cast<long long>(db.zcard(tokens[1])));
+}
+static std::string zrankReply(const CommandArgs& tokens,RedisDatabase& db,bool reverse){
+    size_t rank;
+    if(!db.zrank(tokens[1],tokens[2],reverse,rank)){
+        return "$-1\r\n";
+    }
+    return integerReply(static_cast<long long>(rank));
+}
+static std::string handleZrank(const CommandArgs& tokens,RedisDatabase& db){
+    return zrankReply(tokens,db,false);
+}
+static std::string handleZrevrank(const CommandArgs& tokens,RedisDatabase& db){
+    return zrankReply(tokens,db,true);
+}
+//ZRANGE/ZREVRANGE key start stop [WITHSCORES]
+static std::string zrangeReply(const CommandArgs& tokens,RedisDatabase& db,bool reverse){
+    bool withScores=tokens.size()==5 && equalsIgnoreCase(tokens[4],"WITHSCORES");
+    if(tokens.size()>5 || (tokens.size()==5 && !withScores)){
+        return "-Error: syntax error\r\n";
+    }
+    long long start,stop;
+    try{
+        start=toLongLong(tokens[2]);
+        stop=toLongLong(tokens[3]);
+    }catch(const std::invalid_argument&){
+        return "-Error: value is not an integer or out of range\r\n";
+    }
+    return zsetReply(db.zrange(tokens[1],start,stop,reverse),withScores);
+}
+static std::string handleZrange(const CommandArgs& tokens,RedisDatabase& db){
+    return zrangeReply(tokens,db,false);
+}
+static std::string handleZrevrange(const CommandArgs& tokens,RedisDatabase& db){
+    return zrangeReply(tokens,db,true);
+}
+//ZRANGEBYSCORE key min max / ZREVRANGEBYSCORE key max min, then [WITHSCORES] [LIMIT offset count]
+static std::string zrangeByScoreReply(const CommandArgs& tokens,RedisDatabase& db,bool reverse){
+    ScoreRange range;
+    std::string_view min=tokens[reverse?3:2],max=tokens[reverse?2:3];
+    if(!parseScoreBound(min,range.min,range.min_exclusive) || !parseScoreBound(max,range.max,range.max_exclusive)){
+        return "-Error: min or max is not a float\r\n";
+    }
+    bool withScores=false;
+    long long offset=0,count=-1;
+    for(size_t i=4;i<tokens.size();i++){
+        if(equalsIgnoreCase(tokens[i],"WITHSCORES")){
+            withScores=true;
+        }else if(equalsIgnoreCase(tokens[i],"LIMIT") && i+2<tokens.size()){
+            try{
+                offset=toLongLong(tokens[i+1]);
+                count=toLongLong(tokens[i+2]);
+            }catch(const std::invalid_argument&){
+                return "-Error: value is not an integer or out of range\r\n";
+            }
+            i+=2;
+        }else{
+            return "-Error: syntax error\r\n";
+        }
+    }
+    return zsetReply(db.zrangeByScore(tokens[1],range,reverse,offset,count),withScores);
+}
+static std::string handleZrangebyscore(const CommandArgs& tokens,RedisDatabase& db){
+    return zrangeByScoreReply(tokens,db,false);
+}
+static std::string handleZrevrangebyscore(const CommandArgs& tokens,RedisDatabase& db){
+    return zrangeByScoreReply(tokens,db,true);
+}
+static std::string handleZcount(const CommandArgs& tokens,RedisDatabase& db){
+    ScoreRange range;
+    if(!parseScoreBound(tokens[2],range.min,range.min_exclusive) || !parseScoreBound(tokens[3],range.max,range.max_exclusive)){
+        return "-Error: min or max is not a float\r\n";
+    }
+    return integerReply(static_cast<long long>(db.zcount(tokens[1],range)));
+}
 
-    else if(cmd=="SET"){
-        return handleSet(tokens,db);
-    }
-    else if(cmd=="GET"){
-        return handleGet(tokens,db);
-    }
-    else if(cmd=="KEYS")
-       return handleKeys(tokens,db);
-    else if(cmd=="TYPE")
-        return handleType(tokens,db);
-    else if(cmd=="DEL" || cmd=="UNLINK")
-        return handleDel(tokens,db);
-    else if(cmd=="EXPIRE")
-        return handleExpire(tokens,db);
-    else if(cmd=="RENAME")
-        return handleRename(tokens,db);
-    //List operations
-    else if(cmd=="LGET"){
-        return handleLget(tokens,db);
+//Set operations
+static std::string membersReply(const std::vector<std::string>& members){
+    std::string reply="*"+std::to_string(members.size())+"\r\n";
+    for(const auto& member:members){
+        reply+=bulkReply(member);
     }
-    else if(cmd=="LLEN"){
-        return handleLlen(tokens,db);
+    return reply;
+}
+static std::string handleSadd(const CommandArgs& tokens,RedisDatabase& db){
+    std::vector<std::string_view> members(tokens.begin()+2,tokens.end());
+    return integerReply(static_cast<long long>(db.sadd(tokens[1],members)));
+}
+static std::string handleSrem(const CommandArgs& tokens,RedisDatabase& db){
+    std::vector<std::string_view> members(tokens.begin()+2,tokens.end());
+    return integerReply(static_cast<long long>(db.srem(tokens[1],members)));
+}
+static std::string handleSismember(const CommandArgs& tokens,RedisDatabase& db){
+    return integerReply(db.sismember(tokens[1],tokens[2])?1:0);
+}
+static std::string handleSmismember(const CommandArgs& tokens,RedisDatabase& db){
+    std::vector<std::string_view> members(tokens.begin()+2,tokens.end());
+    std::vector<bool> found=db.smismember(tokens[1],members);
+    std::string reply="*"+std::to_string(found.size())+"\r\n";
+    for(bool f:found){
+        reply+=f?":1\r\n":":0\r\n";
+    }
+    return reply;
+}
+static std::string handleScard(const CommandArgs& tokens,RedisDatabase& db){
+    return integerReply(static_cast<long long>(db.scard(tokens[1])));
+}
+static std::string handleSmembers(const CommandArgs& tokens,RedisDatabase& db){
+    return membersReply(db.smembers(tokens[1]));
+}
+//SINTER/SUNION/SDIFF key [key ...]: computed server-side, so filtering by several tag
+//sets costs one round trip and moves only the result.
+static std::string handleSinter(const CommandArgs& tokens,RedisDatabase& db){
+    return membersReply(db.setOperation(SetOperation::INTER,keyArgs(tokens)));
+}
+static std::string handleSunion(const CommandArgs& tokens,RedisDatabase& db){
+    return membersReply(db.setOperation(SetOperation::UNION,keyArgs(tokens)));
+}
+static std::string handleSdiff(const CommandArgs& tokens,RedisDatabase& db){
+    return membersReply(db.setOperation(SetOperation::DIFF,keyArgs(tokens)));
+}
+//SINTERSTORE/SUNIONSTORE/SDIFFSTORE destination key [key ...]
+static std::string setStoreReply(const CommandArgs& tokens,RedisDatabase& db,SetOperation op){
+    std::vector<std::string_view> keys(tokens.begin()+2,tokens.end());
+    return integerReply(static_cast<long long>(db.setOperationStore(op,tokens[1],keys)));
+}
+static std::string handleSinterstore(const CommandArgs& tokens,RedisDatabase& db){
+    return setStoreReply(tokens,db,SetOperation::INTER);
+}
+static std::string handleSunionstore(const CommandArgs& tokens,RedisDatabase& db){
+    return setStoreReply(tokens,db,SetOperation::UNION);
+}
+static std::string handleSdiffstore(const CommandArgs& tokens,RedisDatabase& db){
+    return setStoreReply(tokens,db,SetOperation::DIFF);
+}
+//SINTERCARD numkeys key [key ...] [LIMIT limit]
+static std::string handleSintercard(const CommandArgs& tokens,RedisDatabase& db){
+    long long numkeys,limit=0;
+    try{
+        numkeys=toLongLong(tokens[1]);
+    }catch(const std::invalid_argument&){
+        return "-Error: numkeys should be greater than 0\r\n";
     }
-    else if(cmd=="LPUSH"){
-        return handleLpush(tokens,db);
+    if(numkeys<1){
+        return "-Error: numkeys should be greater than 0\r\n";
     }
-    else if(cmd=="RPUSH"){
-        return handleRpush(tokens,db);
+    if(static_cast<size_t>(numkeys)>tokens.size()-2){
+        return "-Error: Number of keys can't be greater than number of args\r\n";
     }
-    else if(cmd=="LPOP"){
-        return handleLpop(tokens,db);
+    size_t end=2+static_cast<size_t>(numkeys);
+    if(end<tokens.size()){
+        if(end+2!=tokens.size() || !equalsIgnoreCase(tokens[end],"LIMIT")){
+            return "-Error: syntax error\r\n";
+        }
+        try{
+            limit=toLongLong(tokens[end+1]);
+        }catch(const std::invalid_argument&){
+            limit=-1;
+        }
+        if(limit<0){
+            return "-Error: LIMIT can't be negative\r\n";
+        }
     }
-    else if(cmd=="RPOP"){
-        return handleRpop(tokens,db);
+    std::vector<std::string_view> keys(tokens.begin()+2,tokens.begin()+end);
+    return integerReply(static_cast<long long>(db.sinterCard(keys,static_cast<size_t>(limit))));
+}
+
+//Server and memory commands
+static size_t residentSetSize(){
+    std::ifstream statm("/proc/self/statm");
+    size_t pages=0,resident=0;
+    if(!(statm>>pages>>resident))return 0;
+    return resident*static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+static std::string bytesToHuman(size_t bytes){
+    const char* units[]={"B","K","M","G","T"};
+    double value=static_cast<double>(bytes);
+    int unit=0;
+    while(value>=1024 && unit<4){
+        value/=1024;
+        unit++;
+    }
+    char buf[32];
+    std::snprintf(buf,sizeof(buf),"%.2f%s",value,units[unit]);
+    return buf;
+}
+static std::string handleInfo(const CommandArgs& tokens,RedisDatabase& db){
+    //INFO, INFO all, or INFO <section> for one of: memory, persistence, stats
+    auto wants=[&](std::string_view section){
+        return tokens.size()<2 || equalsIgnoreCase(tokens[1],"all") || equalsIgnoreCase(tokens[1],section);
+    };
+    std::ostringstream oss;
+    if(wants("memory")){
+        size_t used=db.usedMemory();
+        size_t rss=residentSetSize();
+        oss<<"# Memory\r\n"
+           <<"used_memory:"<<used<<"\r\n"
+           <<"used_memory_human:"<<bytesToHuman(used)<<"\r\n"
+           <<"used_memory_rss:"<<rss<<"\r\n"
+           <<"used_memory_rss_human:"<<bytesToHuman(rss)<<"\r\n"
+           <<"maxmemory:"<<db.getMaxmemory()<<"\r\n"
+           <<"maxmemory_human:"<<bytesToHuman(db.getMaxmemory())<<"\r\n"
+           <<"maxmemory_policy:"<<db.getMaxmemoryPolicy()<<"\r\n"
+           <<"lazyfree_pending_objects:"<<LazyFree::getInstance().pendingObjects()<<"\r\n";
+    }
+    if(wants("persistence")){
+        RedisDatabase::SaveStats save=db.saveStats();
+        if(oss.tellp()>0)oss<<"\r\n";
+        oss<<"# Persistence\r\n"
+           <<"rdb_bgsave_in_progress:"<<save.in_progress<<"\r\n"
+           <<"rdb_last_save_time:"<<save.last_save_time<<"\r\n"
+           <<"rdb_last_bgsave_status:"<<(save.last_ok?"ok":"err")<<"\r\n"
+           <<"rdb_last_save_duration_ms:"<<save.last_duration_ms<<"\r\n"
+           <<"rdb_last_save_bytes:"<<save.last_bytes<<"\r\n";
+        AppendOnlyFile::Stats aof=AppendOnlyFile::getInstance().stats();
+        oss<<"aof_enabled:"<<aof.enabled<<"\r\n"
+           <<"aof_rewrite_in_progress:"<<aof.rewrite_in_progress<<"\r\n"
+           <<"aof_last_rewrite_duration_ms:"<<aof.last_rewrite_duration_ms<<"\r\n"
+           <<"aof_last_bgrewrite_status:"<<(aof.last_rewrite_ok?"ok":"err")<<"\r\n"
+           <<"aof_last_write_status:"<<(aof.last_write_ok?"ok":"err")<<"\r\n";
+        if(aof.enabled){
+            oss<<"aof_current_size:"<<aof.current_size<<"\r\n"
+               <<"aof_base_size:"<<aof.base_size<<"\r\n";
+        }
     }
-    else if(cmd=="LREM"){
-        return handleLrem(tokens,db);
+    if(wants("stats")){
+        if(oss.tellp()>0)oss<<"\r\n";
+        oss<<"# Stats\r\n"
+           <<"expired_keys:"<<db.expiredKeys()<<"\r\n"
+           <<"evicted_keys:"<<db.evictedKeys()<<"\r\n"
+           <<"lazyfreed_objects:"<<LazyFree::getInstance().freedObjects()<<"\r\n"
+           <<"latest_fork_usec:"<<db.saveStats().last_fork_us<<"\r\n";
     }
-    else if(cmd=="LINDEX"){
-        return handleLindex(tokens,db);
+    std::string info=oss.str();
+    return "$"+std::to_string(info.size())+"\r\n"+info+"\r\n";
+}
+static std::string handleSave(const CommandArgs& /*tokens*/,RedisDatabase& db){
+    if(!db.dump("dump.my_rdb")){
+        return "-Error: failed to save dump.my_rdb\r\n";
     }
-    else if(cmd=="LSET"){
-        return handleLset(tokens,db);
+    return "+OK\r\n";
+}
+static std::string handleBgsave(const CommandArgs& /*tokens*/,RedisDatabase& db){
+    if(db.saveStats().in_progress){
+        return "-Error: Background save already in progress\r\n";
     }
-    //Hash Operations
-    else if(cmd=="HSET"){
-        return handleHset(tokens,db);
+    if(!db.bgsave("dump.my_rdb")){
+        return "-Error: could not start background save\r\n";
     }
-    else if(cmd=="HGET"){
-        return handleHget(tokens,db);
+    return "+Background saving started\r\n";
+}
+static std::string handleBgrewriteaof(const CommandArgs& /*tokens*/,RedisDatabase& /*db*/){
+    AppendOnlyFile& aof=AppendOnlyFile::getInstance();
+    if(!aof.isEnabled()){
+        return "-Error: append only file is disabled (start with --appendonly yes)\r\n";
     }
-    else if(cmd=="HEXISTS"){
-        return handleHexists(tokens,db);
+    if(aof.stats().rewrite_in_progress){
+        return "-Error: Background append only file rewriting already in progress\r\n";
     }
-    else if(cmd=="HDEL"){
-        return handleHdel(tokens,db);
+    if(!aof.rewriteInBackground()){
+        return "-Error: could not start append only file rewrite\r\n";
     }
-    else if(cmd=="HGETALL"){
-        return handleHgetall(tokens,db);
+    return "+Background append only file rewriting started\r\n";
+}
+static std::string handleConfig(const CommandArgs& tokens,RedisDatabase& db){
+    if(equalsIgnoreCase(tokens[1],"GET") && tokens.size()==3){
+        std::vector<std::pair<std::string,std::string>> params;
+        if(equalsIgnoreCase(tokens[2],"maxmemory") || tokens[2]=="*"){
+            params.emplace_back("maxmemory",std::to_string(db.getMaxmemory()));
+        }
+        if(equalsIgnoreCase(tokens[2],"maxmemory-policy") || tokens[2]=="*"){
+            params.emplace_back("maxmemory-policy",db.getMaxmemoryPolicy());
+        }
+        if(equalsIgnoreCase(tokens[2],"hash-max-listpack-entries") || tokens[2]=="*"){
+            params.emplace_back("hash-max-listpack-entries",std::to_string(db.getHashMaxListpackEntries()));
+        }
+        if(equalsIgnoreCase(tokens[2],"hash-max-listpack-value") || tokens[2]=="*"){
+            params.emplace_back("hash-max-listpack-value",std::to_string(db.getHashMaxListpackValue()));
+        }
+        if(equalsIgnoreCase(tokens[2],"zset-max-listpack-entries") || tokens[2]=="*"){
+            params.emplace_back("zset-max-listpack-entries",std::to_string(db.getZsetMaxListpackEntries()));
+        }
+        if(equalsIgnoreCase(tokens[2],"zset-max-listpack-value") || tokens[2]=="*"){
+            params.emplace_back("zset-max-listpack-value",std::to_string(db.getZsetMaxListpackValue()));
+        }
+        if(equalsIgnoreCase(tokens[2],"set-max-intset-entries") || tokens[2]=="*"){
+            params.emplace_back("set-max-intset-entries",std::to_string(db.getSetMaxIntsetEntries()));
+        }
+        if(equalsIgnoreCase(tokens[2],"lazyfree-lazy-user-del") || tokens[2]=="*"){
+            params.emplace_back("lazyfree-lazy-user-del",db.getLazyfreeLazyUserDel()?"yes":"no");
+        }
+        if(equalsIgnoreCase(tokens[2],"appendonly") || tokens[2]=="*"){
+            params.emplace_back("appendonly",AppendOnlyFile::getInstance().isEnabled()?"yes":"no");
+        }
+        if(equalsIgnoreCase(tokens[2],"appendfsync") || tokens[2]=="*"){
+            params.emplace_back("appendfsync",AppendOnlyFile::getInstance().getFsyncPolicy());
+        }
+        std::ostringstream oss;
+        oss<<"*"<<params.size()*2<<"\r\n";
+        for(const auto& param:params){
+            oss<<"$"<<param.first.size()<<"\r\n"<<param.first<<"\r\n";
+            oss<<"$"<<param.second.size()<<"\r\n"<<param.second<<"\r\n";
+        }
+        return oss.str();
+    }
+    if(equalsIgnoreCase(tokens[1],"SET") && tokens.size()==4){
+        if(equalsIgnoreCase(tokens[2],"maxmemory")){
+            size_t bytes=0;
+            if(!RedisDatabase::parseMemorySize(tokens[3],bytes)){
+                return "-Error: invalid maxmemory value\r\n";
+            }
+            db.setMaxmemory(bytes);
+            //apply a lowered limit right away
+            AppendOnlyFile& aof=AppendOnlyFile::getInstance();
+            std::shared_lock<std::shared_mutex> gate;
+            if(aof.isEnabled())gate=aof.writeGate();
+            std::vector<std::string> evicted;
+            db.checkAndEvict(aof.isEnabled()?&evicted:nullptr);
+            propagateEvictions(aof,evicted);
+            return "+OK\r\n";
+        }
+        if(equalsIgnoreCase(tokens[2],"maxmemory-policy")){
+            if(!db.setMaxmemoryPolicy(tokens[3])){
+                return "-Error: invalid maxmemory-policy (allkeys-apc, allkeys-random, noeviction)\r\n";
+            }
+            return "+OK\r\n";
+        }
+        if(equalsIgnoreCase(tokens[2],"hash-max-listpack-entries") || equalsIgnoreCase(tokens[2],"hash-max-listpack-value") ||
+           equalsIgnoreCase(tokens[2],"zset-max-listpack-entries") || equalsIgnoreCase(tokens[2],"zset-max-listpack-value") ||
+           equalsIgnoreCase(tokens[2],"set-max-intset-entries")){
+            long long limit;
+            try{
+                limit=toLongLong(tokens[3]);
+            }catch(const std::invalid_argument&){
+                limit=-1;
+            }
+            if(limit<0){
+                return "-Error: invalid "+std::string(tokens[2])+" value\r\n";
+            }
+            //existing listpacks and intsets are held to the new limits on their next write
+            if(equalsIgnoreCase(tokens[2],"hash-max-listpack-entries"))db.setHashMaxListpackEntries(limit);
+            else if(equalsIgnoreCase(tokens[2],"hash-max-listpack-value"))db.setHashMaxListpackValue(limit);
+            else if(equalsIgnoreCase(tokens[2],"zset-max-listpack-entries"))db.setZsetMaxListpackEntries(limit);
+            else if(equalsIgnoreCase(tokens[2],"zset-max-listpack-value"))db.setZsetMaxListpackValue(limit);
+            else db.setSetMaxIntsetEntries(limit);
+            return "+OK\r\n";
+        }
+        if(equalsIgnoreCase(tokens[2],"lazyfree-lazy-user-del")){
+            if(!equalsIgnoreCase(tokens[3],"yes") && !equalsIgnoreCase(tokens[3],"no")){
+                return "-Error: invalid lazyfree-lazy-user-del (yes, no)\r\n";
+            }
+            db.setLazyfreeLazyUserDel(equalsIgnoreCase(tokens[3],"yes"));
+            return "+OK\r\n";
+        }
+        if(equalsIgnoreCase(tokens[2],"appendfsync")){
+            AofFsync policy;
+            if(!AppendOnlyFile::parseFsyncPolicy(tokens[3],policy)){
+                return "-Error: invalid appendfsync (always, everysec, no)\r\n";
+            }
+            AppendOnlyFile::getInstance().setFsyncPolicy(policy);
+            return "+OK\r\n";
+        }
+        return "-Error: unsupported CONFIG parameter '"+std::string(tokens[2])+"'\r\n";
     }
-    else if(cmd=="HKEYS"){
-        return handleHkeys(tokens,db);
+    return "-Error: CONFIG usage: CONFIG GET <parameter> | CONFIG SET <parameter> <value>\r\n";
+}
+static std::string handleMemory(const CommandArgs& tokens,RedisDatabase& db){
+    if(!equalsIgnoreCase(tokens[1],"USAGE") || tokens.size()!=3){
+        return "-Error: MEMORY usage: MEMORY USAGE <key>\r\n";
     }
-    else if(cmd=="HVALS"){
-        return handleHvals(tokens,db);
+    size_t bytes=0;
+    if(!db.memoryUsage(tokens[2],bytes)){
+        return "$-1\r\n";
     }
-    else if(cmd=="HLEN"){
-        return handleHlen(tokens,db);
+    return ":"+std::to_string(bytes)+"\r\n";
+}
+
+static std::string handleObject(const CommandArgs& tokens,RedisDatabase& db){
+    if(!equalsIgnoreCase(tokens[1],"ENCODING") || tokens.size()!=3){
+        return "-Error: OBJECT usage: OBJECT ENCODING <key>\r\n";
     }
-    else if(cmd=="HMSET"){
-        return handleHmset(tokens,db);
+    std::string encoding;
+    if(!db.objectEncoding(tokens[2],encoding)){
+        return "$-1\r\n";
     }
+    return "$"+std::to_string(encoding.size())+"\r\n"+encoding+"\r\n";
+}
 
-    else{
-        return "-ERROR: Unkown command\r\n";
+//Command table: name, arity, flags, handler.
+static const RedisCommand commandTable[]={
+    //Common commands
+    {"PING",     -1, CMD_READONLY,           handlePing},
+    {"ECHO",      2, CMD_READONLY,           handleEcho},
+    {"FLUSHALL", -1, CMD_WRITE,              handleFlushAll},
+    //Key/Value Operations
+    {"SET",      -3, CMD_WRITE|CMD_DENYOOM,  handleSet},
+    {"GET",       2, CMD_READONLY,           handleGet},
+    {"MGET",     -2, CMD_READONLY,           handleMget},
+    {"MSET",     -3, CMD_WRITE|CMD_DENYOOM,  handleMset},
+    {"MSETNX",   -3, CMD_WRITE|CMD_DENYOOM,  handleMsetnx},
+    {"INCR",      2, CMD_WRITE|CMD_DENYOOM,  handleIncr},
+    {"DECR",      2, CMD_WRITE|CMD_DENYOOM,  handleDecr},
+    {"INCRBY",    3, CMD_WRITE|CMD_DENYOOM,  handleIncrby},
+    {"DECRBY",    3, CMD_WRITE|CMD_DENYOOM,  handleDecrby},
+    {"INCRBYFLOAT",3,CMD_WRITE|CMD_DENYOOM,  handleIncrbyfloat},
+    {"APPEND",    3, CMD_WRITE|CMD_DENYOOM,  handleAppend},
+    {"SETRANGE",  4, CMD_WRITE|CMD_DENYOOM,  handleSetrange},
+    {"GETRANGE",  4, CMD_READONLY,           handleGetrange},
+    {"STRLEN",    2, CMD_READONLY,           handleStrlen},
+    {"KEYS",     -1, CMD_READONLY,           handleKeys},
+    {"SCAN",     -2, CMD_READONLY,           handleScan},
+    {"TYPE",      2, CMD_READONLY,           handleType},
+    {"DEL",      -2, CMD_WRITE,              handleDel},
+    {"UNLINK",   -2, CMD_WRITE,              handleUnlink},
+    {"EXISTS",   -2, CMD_READONLY,           handleExists},
+    {"EXPIRE",    3, CMD_WRITE,              handleExpire},
+    {"PEXPIRE",   3, CMD_WRITE,              handlePexpire},
+    {"EXPIREAT",  3, CMD_WRITE,              handleExpireat},
+    {"PEXPIREAT", 3, CMD_WRITE,              handlePexpireat},
+    {"TTL",       2, CMD_READONLY,           handleTtl},
+    {"PTTL",      2, CMD_READONLY,           handlePttl},
+    {"PERSIST",   2, CMD_WRITE,              handlePersist},
+    {"RENAME",    3, CMD_WRITE,              handleRename},
+    //List operations
+    {"LGET",      2, CMD_READONLY,           handleLget},
+    {"LLEN",      2, CMD_READONLY,           handleLlen},
+    {"LPUSH",    -3, CMD_WRITE|CMD_DENYOOM,  handleLpush},
+    {"RPUSH",    -3, CMD_WRITE|CMD_DENYOOM,  handleRpush},
+    {"LPOP",      2, CMD_WRITE,              handleLpop},
+    {"RPOP",      2, CMD_WRITE,              handleRpop},
+    {"LREM",      4, CMD_WRITE,              handleLrem},
+    {"LINDEX",    3, CMD_READONLY,           handleLindex},
+    {"LSET",      4, CMD_WRITE|CMD_DENYOOM,  handleLset},
+    //Hash Operations
+    {"HSET",     -4, CMD_WRITE|CMD_DENYOOM,  handleHset},
+    {"HGET",      3, CMD_READONLY,           handleHget},
+    {"HEXISTS",   3, CMD_READONLY,           handleHexists},
+    {"HDEL",     -3, CMD_WRITE,              handleHdel},
+    {"HGETALL",   2, CMD_READONLY,           handleHgetall},
+    {"HKEYS",     2, CMD_READONLY,           handleHkeys},
+    {"HVALS",     2, CMD_READONLY,           handleHvals},
+    {"HLEN",      2, CMD_READONLY,           handleHlen},
+    {"HMSET",    -4, CMD_WRITE|CMD_DENYOOM,  handleHmset},
+    {"HSCAN",    -3, CMD_READONLY,           handleHscan},
+    //Sorted set operations
+    {"ZADD",     -4, CMD_WRITE|CMD_DENYOOM,  handleZadd},
+    {"ZINCRBY",   4, CMD_WRITE|CMD_DENYOOM,  handleZincrby},
+    {"ZSCORE",    3, CMD_READONLY,           handleZscore},
+    {"ZREM",     -3, CMD_WRITE,              handleZrem},
+    {"ZCARD",     2, CMD_READONLY,           handleZcard},
+    {"ZRANK",     3, CMD_READONLY,           handleZrank},
+    {"ZREVRANK",  3, CMD_READONLY,           handleZrevrank},
+    {"ZRANGE",   -4, CMD_READONLY,           handleZrange},
+    {"ZREVRANGE",-4, CMD_READONLY,           handleZrevrange},
+    {"ZRANGEBYSCORE",-4,CMD_READONLY,        handleZrangebyscore},
+    {"ZREVRANGEBYSCORE",-4,CMD_READONLY,     handleZrevrangebyscore},
+    {"ZCOUNT",    4, CMD_READONLY,           handleZcount},
+    //Set operations
+    {"SADD",     -3, CMD_WRITE|CMD_DENYOOM,  handleSadd},
+    {"SREM",     -3, CMD_WRITE,              handleSrem},
+    {"SISMEMBER", 3, CMD_READONLY,           handleSismember},
+    {"SMISMEMBER",-3,CMD_READONLY,           handleSmismember},
+    {"SCARD",     2, CMD_READONLY,           handleScard},
+    {"SMEMBERS",  2, CMD_READONLY,           handleSmembers},
+    {"SSCAN",    -3, CMD_READONLY,           handleSscan},
+    {"SINTER",   -2, CMD_READONLY,           handleSinter},
+    {"SUNION",   -2, CMD_READONLY,           handleSunion},
+    {"SDIFF",    -2, CMD_READONLY,           handleSdiff},
+    {"SINTERSTORE",-3,CMD_WRITE|CMD_DENYOOM, handleSinterstore},
+    {"SUNIONSTORE",-3,CMD_WRITE|CMD_DENYOOM, handleSunionstore},
+    {"SDIFFSTORE",-3,CMD_WRITE|CMD_DENYOOM,  handleSdiffstore},
+    {"SINTERCARD",-3,CMD_READONLY,           handleSintercard},
+    //Server
+    {"INFO",     -1, CMD_ADMIN,              handleInfo},
+    {"CONFIG",   -3, CMD_ADMIN,              handleConfig},
+    {"SAVE",      1, CMD_ADMIN,              handleSave},
+    {"BGSAVE",    1, CMD_ADMIN,              handleBgsave},
+    {"BGREWRITEAOF",1,CMD_ADMIN,             handleBgrewriteaof},
+    {"MEMORY",   -2, CMD_READONLY,           handleMemory},
+    {"OBJECT",   -2, CMD_READONLY,           handleObject},
+};
+
+//Case-insensitive hashing/equality so lookups can use the raw argument view
+//without upper-casing it into a temporary string.
+struct CaseInsensitiveHash {
+    size_t operator()(std::string_view s) const {
+        size_t h=1469598103934665603ULL; //FNV-1a
+        for(char ch:s){
+            h^=static_cast<unsigned char>(std::toupper(static_cast<unsigned char>(ch)));
+            h*=1099511628211ULL;
+        }
+        return h;
+    }
+};
+struct CaseInsensitiveEqual {
+    bool operator()(std::string_view a,std::string_view b) const {
+        return equalsIgnoreCase(a,b);
+    }
+};
+using CommandIndex=std::unordered_map<std::string_view,const RedisCommand*,CaseInsensitiveHash,CaseInsensitiveEqual>;
+
+static const CommandIndex& commandIndex(){
+    //built once, on first use; keys view the string literals in commandTable
+    static const CommandIndex index=[]{
+        CommandIndex idx;
+        idx.reserve(sizeof(commandTable)/sizeof(commandTable[0]));
+        for(const RedisCommand& command:commandTable){
+            idx.emplace(command.name,&command);
+        }
+        return idx;
+    }();
+    return index;
+}
+
+const RedisCommand* RedisCommandHandler::lookupCommand(std::string_view name){
+    const CommandIndex& index=commandIndex();
+    auto it=index.find(name);
+    return it==index.end()?nullptr:it->second;
+}
+
+RedisCommandHandler::RedisCommandHandler(){
+    commandIndex(); //build the dispatch index at startup rather than on the first request
+}
+
+std::string RedisCommandHandler::processCommand(const std::string& commandLine){
+    //use RESP protocol; every complete command in the input is executed in order
+    RespParser parser;
+    CommandArgs tokens;
+    std::string response;
+    while(true){
+        RespParser::Result r=parser.next(commandLine,tokens);
+        if(r==RespParser::COMMAND_READY){
+            response+=processCommand(tokens);
+        }else{
+            if(r==RespParser::PROTOCOL_ERROR){
+                response+="-Error: "+parser.errorMessage()+"\r\n";
+            }
+            break;
+        }
     }
+    if(response.empty())return "-Error:Empty command\r\n";
+    return response;
+}
 
-}
\ No newline at end of file
+std::string RedisCommandHandler::processCommand(const CommandArgs& tokens){
+    if(tokens.empty())return "-Error:Empty command\r\n";
+
+    const RedisCommand* command=lookupCommand(tokens[0]);
+    if(command==nullptr){
+        return "-ERROR: Unkown command\r\n";
+    }
+    //reject bad calls before the handler touches (or allocates for) anything
+    if(!command->acceptsArgCount(tokens.size())){
+        return "-Error: wrong number of arguments for '"+std::string(command->name)+"' command\r\n";
+    }
+    RedisDatabase& db=RedisDatabase::getInstance();
+    AppendOnlyFile& aof=AppendOnlyFile::getInstance();
+    //a write command holds the AOF gate until it is logged, so a rewrite never forks
+    //between a change to the keyspace and its log entry
+    bool logged=(command->flags&CMD_WRITE) && aof.isEnabled();
+    std::shared_lock<std::shared_mutex> gate;
+    if(logged)gate=aof.writeGate();
+    //like Redis, make room before a command that may grow memory rather than after it
+    if(command->flags&CMD_DENYOOM){
+        std::vector<std::string> evicted;
+        bool fits=db.checkAndEvict(logged?&evicted:nullptr);
+        propagateEvictions(aof,evicted);
+        if(!fits){
+            return "-OOM command not allowed when used memory > 'maxmemory'.\r\n";
+        }
+    }
+    std::string reply;
+    appliedDeadlineMs=0;
+    try{
+        reply=command->handler(tokens,db);
+    }catch(const WrongTypeError& e){
+        return "-"+std::string(e.what())+"\r\n";
+    }catch(const CommandError& e){
+        return "-"+std::string(e.what())+"\r\n";
+    }
+    if(logged && reply[0]!='-'){
+        feedAppendOnlyFile(aof,tokens,reply);
+    }
+    return reply;
+}
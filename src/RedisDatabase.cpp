@@ -1,10 +1,29 @@
-#include "D:\\projects\\Enhanced-Redis\\include\\RedisDatabase.h"
+#include "../include/RedisDatabase.h"
 #include <fstream> // file stream
 #include <sstream>
 #include <algorithm>
 #include <iterator>
 #include <chrono>
-#include <unordered_set> // For consolidating keys in `keys()` command
+#include <charconv>
+#include <cctype>
+#include <limits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include "../include/Snapshot.h"
+#include "../include/LazyFree.h"
+#include "../include/StringMatch.h"
+#include "../include/Intset.h"
+#include <unordered_set>
 
 // Singleton accessor
 RedisDatabase& RedisDatabase::getInstance() {
@@ -12,606 +31,2157 @@ RedisDatabase& RedisDatabase::getInstance() {
     return instance;
 }
 
-// Private helper to get total key count across all stores
-size_t RedisDatabase::getTotalKeyCount() const {
-    // Note: This counts the number of keys in each store, not unique keys across all stores.
-    // For a more accurate unique key count, one would need to iterate and add to a set.
-    // However, for eviction trigger purposes, this approximation is often sufficient.
-    return kv_store.size() + list_store.size() + hash_store.size();
+// Private helper for internal deletion without locking or expiration checks
+bool RedisDatabase::Shard::delInternal(std::string_view key, bool lazy) {
+    std::optional<RedisObject> obj = keyspace.take(key);
+    predictive_cache.removeKey(key);
+    if (!obj) {
+        return false;
+    }
+    data_bytes -= entryBytes(key, *obj);
+    if (lazy && obj->freeEffort() > LazyFree::THRESHOLD) {
+        LazyFree::getInstance().reclaim(std::move(*obj));
+    }
+    return true;
 }
 
-// Private helper for internal deletion without locking or expiration checks
-bool RedisDatabase::delInternal(const std::string& key) {
-    bool erased = false;
-    erased |= kv_store.erase(key) > 0;
-    erased |= list_store.erase(key) > 0;
-    erased |= hash_store.erase(key) > 0;
-    if (erased) {
-        predictive_cache.removeKey(key);
+RedisObject& RedisDatabase::Shard::insert(std::string_view key, RedisObject&& obj) {
+    data_bytes += entryBytes(key, obj);
+    return *keyspace.emplace(key, std::move(obj)).first;
+}
+
+RedisObject* RedisDatabase::Shard::lookup(std::string_view key) {
+    RedisObject* obj = keyspace.find(key);
+    if (obj == nullptr) {
+        return nullptr;
+    }
+    if (obj->isExpiredAt(currentTimeMs())) {
+        // Lazy expiration: drop the key the first time it is touched after its deadline
+        delInternal(key, true);
+        expired_keys.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return obj;
+}
+
+RedisObject* RedisDatabase::Shard::lookupTyped(std::string_view key, ObjectType type) {
+    RedisObject* obj = lookup(key);
+    if (obj != nullptr && obj->type != type) {
+        throw WrongTypeError();
     }
-    return erased;
+    return obj;
 }
 
-// Private helper to check if a key is expired based on APC data
-bool RedisDatabase::isExpired(const std::string& key) {
-    if (!predictive_cache.contains(key)) {
-        return false; // Key is not managed by APC for expiration (no TTL set)
+RedisObject& RedisDatabase::Shard::lookupOrCreate(std::string_view key, ObjectType type) {
+    RedisObject* obj = lookupTyped(key, type);
+    if (obj != nullptr) {
+        return *obj;
     }
-    // Update score to ensure TTL remaining is current before checking
-    predictive_cache.updateScore(key); // Recalculate score (which also updates internal TTL remaining)
-    return predictive_cache.getTTLRemaining(key) <= 0 && predictive_cache.meta_store[key].ttl_initial_seconds > 0;
+    return insert(key, RedisObject::makeEmpty(type));
 }
 
-// New method for cache eviction
-void RedisDatabase::checkAndEvict() {
-    // If the total number of distinct keys exceeds the max cache size
-    if (getTotalKeyCount() <= max_cache_size) {
-        return; // No eviction needed yet
+void RedisDatabase::Shard::setExpire(std::string_view key, RedisObject& obj, long long deadline_ms) {
+    obj.expire_at_ms = deadline_ms;
+    const Dict<RedisObject>& table = keyspace;
+    expires.add(deadline_ms, key, [&table](const ExpiryIndex::Entry& e) {
+        const RedisObject* current = table.find(e.key);
+        return current != nullptr && current->expire_at_ms == e.deadline_ms;
+    });
+}
+
+void RedisDatabase::Shard::restore(std::string_view key, RedisObject&& obj, long long expire_at_ms,
+                                   const KeyStats& stats, std::chrono::steady_clock::time_point now) {
+    if (keyspace.find(key) != nullptr) {
+        delInternal(key); // a damaged file may repeat a key: the last copy wins
+    }
+    RedisObject& stored = insert(key, std::move(obj));
+    if (expire_at_ms > 0) {
+        setExpire(key, stored, expire_at_ms);
     }
+    predictive_cache.loadKey(key, stats, now);
+}
 
-    std::string keyToEvict = predictive_cache.evictCandidate();
-    if (keyToEvict.empty()) {
-        // This can happen if meta_store is empty, but getTotalKeyCount() > 0 (e.g., keys without any access/TTL)
-        // Or if all keys have extremely high scores (less likely with current scoring)
-        // Fallback: if APC can't decide, just remove an arbitrary key (e.g., from kv_store if not empty)
-        if (!kv_store.empty()) {
-            keyToEvict = kv_store.begin()->first;
-        } else if (!list_store.empty()) {
-            keyToEvict = list_store.begin()->first;
-        } else if (!hash_store.empty()) {
-            keyToEvict = hash_store.begin()->first;
-        } else {
-            return; // Really nothing to evict
+size_t RedisDatabase::Shard::expireDueKeys(long long now_ms, size_t max_entries, bool& more) {
+    size_t deleted = 0;
+    for (size_t examined = 0; examined < max_entries && !expires.empty() && expires.nextDeadline() <= now_ms; ++examined) {
+        ExpiryIndex::Entry e = expires.pop();
+        // Skip entries left behind by a TTL that was changed, removed or already enforced
+        RedisObject* obj = keyspace.find(e.key);
+        if (obj != nullptr && obj->expire_at_ms == e.deadline_ms) {
+            delInternal(e.key, true);
+            ++deleted;
         }
     }
+    more = !expires.empty() && expires.nextDeadline() <= now_ms;
+    expired_keys.fetch_add(deleted, std::memory_order_relaxed);
+    return deleted;
+}
 
-    // Remove the chosen key from all data stores and the predictive cache
-    delInternal(keyToEvict);
+bool RedisDatabase::Shard::hashSet(RedisObject& obj, std::string_view field, std::string_view value,
+                                   const ListpackLimits& limits) {
+    if (obj.encoding == ObjectEncoding::LISTPACK) {
+        Listpack& packed = obj.packedHash();
+        std::string_view current;
+        bool fits = limits.fits(field, value) && (packed.size() < limits.entries || packed.find(field, current));
+        if (fits) {
+            data_bytes -= obj.containerBytes();
+            bool added = packed.set(field, value);
+            data_bytes += obj.containerBytes();
+            return added;
+        }
+        data_bytes -= obj.memoryUsage();
+        obj.convertHashToTable();
+        data_bytes += obj.memoryUsage();
+    }
+    data_bytes -= obj.memoryUsage();
+    bool added = obj.hashTableSet(field, value);
+    data_bytes += obj.memoryUsage();
+    return added;
 }
 
-bool RedisDatabase::flushAll() {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    kv_store.clear();
-    list_store.clear();
-    hash_store.clear();
+void RedisDatabase::Shard::zsetSet(RedisObject& obj, std::string_view member, double score,
+                                   const ListpackLimits& limits) {
+    data_bytes -= obj.containerBytes();
+    if (obj.encoding == ObjectEncoding::LISTPACK) {
+        Listpack& packed = obj.packedZset();
+        std::string_view current;
+        bool exists = packed.find(member, current);
+        if (exists || (member.size() <= limits.value && packed.size() < limits.entries)) {
+            if (exists) {
+                packed.erase(member);
+            }
+            // Keep the pairs ordered by (score, member): count those that sort first
+            size_t index = 0;
+            packed.forEach([&](std::string_view m, std::string_view packed_score) {
+                double s = RedisObject::unpackScore(packed_score);
+                if (s < score || (s == score && m < member)) ++index;
+            });
+            char buf[sizeof(double)];
+            packed.insert(index, member, RedisObject::packScore(score, buf));
+            data_bytes += obj.containerBytes();
+            return;
+        }
+        obj.convertZsetToSkiplist();
+    }
+    obj.zset().set(member, score);
+    data_bytes += obj.containerBytes();
+}
+
+bool RedisDatabase::Shard::zsetErase(RedisObject& obj, std::string_view member) {
+    data_bytes -= obj.containerBytes();
+    bool erased = obj.encoding == ObjectEncoding::LISTPACK ? obj.packedZset().erase(member) : obj.zset().erase(member);
+    data_bytes += obj.containerBytes();
+    return erased;
+}
+
+bool RedisDatabase::Shard::setAdd(RedisObject& obj, std::string_view member, size_t max_intset_entries) {
+    data_bytes -= obj.memoryUsage();
+    bool added;
+    long long v;
+    if (obj.encoding == ObjectEncoding::INTSET && RedisObject::parseCanonicalInt(member, v) &&
+        (obj.intset().size() < max_intset_entries || obj.intset().contains(v))) {
+        added = obj.intset().insert(v);
+    } else {
+        if (obj.encoding == ObjectEncoding::INTSET) {
+            obj.convertSetToTable();
+        }
+        added = obj.setTableAdd(member);
+    }
+    data_bytes += obj.memoryUsage();
+    return added;
+}
+
+bool RedisDatabase::Shard::setRemove(RedisObject& obj, std::string_view member) {
+    data_bytes -= obj.memoryUsage();
+    bool removed;
+    if (obj.encoding == ObjectEncoding::INTSET) {
+        long long v;
+        removed = RedisObject::parseCanonicalInt(member, v) && obj.intset().erase(v);
+    } else {
+        removed = obj.setTableErase(member);
+    }
+    data_bytes += obj.memoryUsage();
+    return removed;
+}
+
+std::string RedisDatabase::Shard::evictionCandidate(MaxmemoryPolicy policy) {
+    if (policy == MaxmemoryPolicy::ALLKEYS_APC) {
+        std::string keyToEvict = predictive_cache.evictCandidate();
+        if (!keyToEvict.empty()) {
+            return keyToEvict;
+        }
+        // This can happen if meta_store is empty but the keyspace is not; fall back to a random key
+    }
+    auto* entry = keyspace.sample(rng());
+    return entry == nullptr ? std::string() : entry->key;
+}
+
+void RedisDatabase::Shard::clear(bool lazy) {
+    if (lazy) {
+        // Hand the populated stores over whole; the shard restarts from empty ones
+        LazyFree& lazy_free = LazyFree::getInstance();
+        lazy_free.reclaim(std::move(keyspace));
+        lazy_free.reclaim(std::move(predictive_cache));
+        lazy_free.reclaim(std::move(expires));
+    }
+    keyspace.clear();
     predictive_cache.clear(); // Clear all metadata from the predictive cache
+    expires.clear();
+    data_bytes = 0;
+}
+
+void RedisDatabase::publishMemory(Shard& shard) {
+    size_t now = shard.usedMemory();
+    if (now != shard.reported_bytes) {
+        used_memory.fetch_add(static_cast<long long>(now) - static_cast<long long>(shard.reported_bytes), std::memory_order_relaxed);
+        shard.reported_bytes = now;
+    }
+}
+
+std::vector<std::unique_lock<std::mutex>> RedisDatabase::lockAllShards() {
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(SHARD_COUNT);
+    for (Shard& shard : shards) {
+        locks.emplace_back(shard.mutex);
+    }
+    return locks;
+}
+
+RedisDatabase::MultiShardGuard::MultiShardGuard(RedisDatabase& db, std::vector<size_t> shard_indices)
+    : db(db), indices(std::move(shard_indices)) {
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    locks.reserve(indices.size());
+    for (size_t index : indices) {
+        locks.emplace_back(db.shards[index].mutex);
+    }
+}
+
+// Called before commands that may grow memory (see CMD_DENYOOM) with no shard locked.
+// Shards are visited round-robin and give up one victim each, so eviction pressure is
+// spread across the keyspace instead of landing on whichever shard is being written.
+bool RedisDatabase::checkAndEvict(std::vector<std::string>* evicted) {
+    size_t limit = maxmemory.load(std::memory_order_relaxed);
+    if (limit == 0) {
+        return true; // No limit configured
+    }
+    MaxmemoryPolicy policy = maxmemory_policy.load(std::memory_order_relaxed);
+    size_t emptyShards = 0;
+    while (usedMemory() > limit) {
+        if (policy == MaxmemoryPolicy::NOEVICTION) {
+            return false;
+        }
+        Shard& shard = shards[eviction_cursor.fetch_add(1, std::memory_order_relaxed) & (SHARD_COUNT - 1)];
+        ShardGuard guard(*this, shard);
+        std::string keyToEvict = shard.evictionCandidate(policy);
+        if (keyToEvict.empty()) {
+            if (++emptyShards >= SHARD_COUNT) {
+                return false; // Nothing left anywhere to evict
+            }
+            continue;
+        }
+        emptyShards = 0;
+        shard.delInternal(keyToEvict, true);
+        evicted_keys.fetch_add(1, std::memory_order_relaxed);
+        if (evicted) {
+            evicted->push_back(std::move(keyToEvict));
+        }
+    }
     return true;
 }
 
-// Key/value operations
-void RedisDatabase::set(const std::string& key, const std::string& value, double ttl_seconds) {
-    std::lock_guard<std::mutex> lock(db_mutex);
+// Runs off the background expiry thread (see main.cpp). Each shard is locked for one
+// small batch at a time, so client commands on that shard wait at most one batch.
+size_t RedisDatabase::activeExpireCycle(int time_budget_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(time_budget_ms);
+    size_t expired = 0;
+    bool more = true;
+    while (more) { // Sweep again while some shard still had due keys after its batch
+        more = false;
+        for (Shard& shard : shards) {
+            bool shardMore = false;
+            {
+                ShardGuard guard(*this, shard);
+                expired += shard.expireDueKeys(currentTimeMs(), ACTIVE_EXPIRE_BATCH, shardMore);
+            }
+            more = more || shardMore;
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return expired; // Out of time; the rest waits for the next cycle
+            }
+        }
+    }
+    return expired;
+}
+
+uint64_t RedisDatabase::expiredKeys() const {
+    uint64_t total = 0;
+    for (const Shard& shard : shards) {
+        total += shard.expired_keys.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+size_t RedisDatabase::usedMemory() const {
+    long long bytes = used_memory.load(std::memory_order_relaxed);
+    return bytes > 0 ? static_cast<size_t>(bytes) : 0;
+}
+
+bool RedisDatabase::memoryUsage(std::string_view key, size_t& bytes) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookup(key);
+    if (obj == nullptr) {
+        return false;
+    }
+    // The key's slot in the table counts too, as Redis counts its dictEntry
+    bytes = Shard::entryBytes(key, *obj) + sizeof(Dict<RedisObject>::Entry) + 1;
+    return true;
+}
+
+bool RedisDatabase::setMaxmemoryPolicy(std::string_view name) {
+    if (name == "allkeys-apc") {
+        maxmemory_policy.store(MaxmemoryPolicy::ALLKEYS_APC);
+    } else if (name == "allkeys-random") {
+        maxmemory_policy.store(MaxmemoryPolicy::ALLKEYS_RANDOM);
+    } else if (name == "noeviction") {
+        maxmemory_policy.store(MaxmemoryPolicy::NOEVICTION);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* RedisDatabase::getMaxmemoryPolicy() const {
+    switch (maxmemory_policy.load()) {
+        case MaxmemoryPolicy::ALLKEYS_APC: return "allkeys-apc";
+        case MaxmemoryPolicy::ALLKEYS_RANDOM: return "allkeys-random";
+        case MaxmemoryPolicy::NOEVICTION: return "noeviction";
+    }
+    return "allkeys-apc";
+}
 
-    // If the key exists but is expired, remove it first (Redis SET behavior)
-    if (predictive_cache.contains(key) && isExpired(key)) {
-        delInternal(key);
+bool RedisDatabase::parseMemorySize(std::string_view text, size_t& bytes) {
+    size_t digits = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) {
+        ++digits;
+    }
+    if (digits == 0) {
+        return false;
+    }
+    std::string unit(text.substr(digits));
+    std::transform(unit.begin(), unit.end(), unit.begin(), [](unsigned char c) { return std::tolower(c); });
+    size_t multiplier;
+    if (unit.empty() || unit == "b") multiplier = 1;
+    else if (unit == "k") multiplier = 1000;
+    else if (unit == "kb") multiplier = 1024;
+    else if (unit == "m") multiplier = 1000 * 1000;
+    else if (unit == "mb") multiplier = 1024 * 1024;
+    else if (unit == "g") multiplier = 1000ULL * 1000 * 1000;
+    else if (unit == "gb") multiplier = 1024ULL * 1024 * 1024;
+    else return false;
+
+    size_t value = 0;
+    auto res = std::from_chars(text.data(), text.data() + digits, value);
+    if (res.ec != std::errc() || value > std::numeric_limits<size_t>::max() / multiplier) {
+        return false;
     }
+    bytes = value * multiplier;
+    return true;
+}
+
+bool RedisDatabase::flushAll(bool async) {
+    auto locks = lockAllShards();
+    for (Shard& shard : shards) {
+        shard.clear(async);
+        publishMemory(shard);
+    }
+    return true;
+}
 
-    kv_store[key] = value;
+// Key/value operations
+bool RedisDatabase::Shard::setString(std::string_view key, std::string_view value, long long expire_at_ms, int flags) {
+    // SET overwrites whatever the key held before, whatever its type (Redis SET behavior)
+    RedisObject* obj = lookup(key);
+    if (((flags & SET_NX) && obj != nullptr) || ((flags & SET_XX) && obj == nullptr)) {
+        return false;
+    }
+    long long kept_deadline = (flags & SET_KEEPTTL) && obj != nullptr ? obj->expire_at_ms : 0;
+    if (obj != nullptr && obj->type == ObjectType::STRING) {
+        data_bytes -= obj->containerBytes();
+        obj->setString(value); // a RAW value reuses its buffer
+        obj->expire_at_ms = 0;
+        data_bytes += obj->containerBytes();
+    } else if (obj != nullptr) {
+        data_bytes -= obj->memoryUsage();
+        if (obj->freeEffort() > LazyFree::THRESHOLD) {
+            LazyFree::getInstance().reclaim(std::move(*obj)); // a large list, hash or sorted set being overwritten
+        }
+        *obj = RedisObject::makeString(value);
+        data_bytes += obj->memoryUsage();
+    } else {
+        obj = &insert(key, RedisObject::makeString(value));
+    }
     predictive_cache.recordAccess(key); // Record access for scoring
 
-    if (ttl_seconds > 0) {
-        predictive_cache.setTTL(key, ttl_seconds);
+    if (expire_at_ms > 0) {
+        setExpire(key, *obj, expire_at_ms);
+        predictive_cache.setTTL(key, (expire_at_ms - currentTimeMs()) / 1000.0);
+    } else if (kept_deadline > 0) {
+        obj->expire_at_ms = kept_deadline; // KEEPTTL: the existing index entry stays valid
     } else {
         // If TTL is set to 0 or not provided, remove any existing TTL
-        if (predictive_cache.contains(key)) {
-            predictive_cache.setTTL(key, 0); // Effectively removes TTL and resets related factors
-        }
+        predictive_cache.setTTL(key, 0); // Effectively removes TTL and resets related factors
     }
-    checkAndEvict(); // Check for eviction after adding/updating a key
+    return true;
+}
+
+bool RedisDatabase::set(std::string_view key, std::string_view value, long long expire_at_ms, int flags) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    return shard.setString(key, value, expire_at_ms, flags);
 }
 
-bool RedisDatabase::get(const std::string& key, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key); // Remove expired key
+bool RedisDatabase::get(std::string_view key, std::string& value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::STRING);
+    if (obj == nullptr) {
         return false;
     }
+    shard.predictive_cache.recordAccess(key); // Record access for scoring
+    value = obj->strValue();
+    return true;
+}
 
-    auto it = kv_store.find(key);
-    if (it != kv_store.end()) {
-        predictive_cache.recordAccess(key); // Record access for scoring
-        value = it->second;
-        return true;
+// Batch operations. Rather than lock per key, the keys are sorted by shard and every
+// shard involved is locked once for all of its keys.
+template <typename KeyOf, typename Fn>
+void RedisDatabase::forEachByShard(size_t count, KeyOf&& keyOf, Fn&& fn) {
+    // (shard, position) pairs: sorting them keeps a shard's positions in argument order,
+    // so a key named twice sees the effect of its first occurrence
+    std::vector<std::pair<uint32_t, uint32_t>> order;
+    order.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        order.emplace_back(static_cast<uint32_t>(shardIndex(keyOf(i))), static_cast<uint32_t>(i));
+    }
+    std::sort(order.begin(), order.end());
+    for (size_t i = 0; i < order.size();) {
+        Shard& shard = shards[order[i].first];
+        ShardGuard guard(*this, shard);
+        size_t end = i;
+        for (; end < order.size() && order[end].first == order[i].first; ++end) {
+            fn(shard, order[end].second);
+        }
+        i = end;
     }
-    return false;
 }
 
-std::vector<std::string> RedisDatabase::keys() {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    std::vector<std::string> result;
+std::vector<std::optional<std::string>> RedisDatabase::mget(const std::vector<std::string_view>& keys) {
+    std::vector<std::optional<std::string>> values(keys.size());
+    forEachByShard(keys.size(), [&](size_t i) { return keys[i]; }, [&](Shard& shard, size_t i) {
+        std::string_view key = keys[i];
+        // A key holding another type reads as missing, as in Redis' MGET
+        RedisObject* obj = shard.lookup(key);
+        if (obj != nullptr && obj->type == ObjectType::STRING) {
+            shard.predictive_cache.recordAccess(key);
+            values[i] = obj->strValue();
+        }
+    });
+    return values;
+}
 
-    // Iterate through all possible keys and filter out expired ones
-    std::unordered_set<std::string> unique_keys;
-    for (const auto& pair : kv_store) unique_keys.insert(pair.first);
-    for (const auto& pair : list_store) unique_keys.insert(pair.first);
-    for (const auto& pair : hash_store) unique_keys.insert(pair.first);
+void RedisDatabase::mset(const std::vector<std::pair<std::string_view, std::string_view>>& keyValues) {
+    forEachByShard(keyValues.size(), [&](size_t i) { return keyValues[i].first; }, [&](Shard& shard, size_t i) {
+        shard.setString(keyValues[i].first, keyValues[i].second, 0, 0);
+    });
+}
 
-    for (const std::string& key : unique_keys) {
-        if (!isExpired(key)) {
-            result.push_back(key);
-            predictive_cache.recordAccess(key); // Accessing key via KEYS also counts as an access
-        } else {
-            delInternal(key); // Remove expired key found during KEYS command
+bool RedisDatabase::msetnx(const std::vector<std::pair<std::string_view, std::string_view>>& keyValues) {
+    // All or nothing, so every involved shard is held at once (in ascending order) from
+    // the existence check to the last write
+    std::vector<size_t> indices;
+    indices.reserve(keyValues.size());
+    for (const auto& kv : keyValues) {
+        indices.push_back(shardIndex(kv.first));
+    }
+    MultiShardGuard guard(*this, std::move(indices));
+
+    for (const auto& kv : keyValues) {
+        if (shards[shardIndex(kv.first)].lookup(kv.first) != nullptr) {
+            return false;
+        }
+    }
+    for (const auto& kv : keyValues) {
+        shards[shardIndex(kv.first)].setString(kv.first, kv.second, 0, 0);
+    }
+    return true;
+}
+
+size_t RedisDatabase::del(const std::vector<std::string_view>& keys, bool lazy) {
+    size_t deleted = 0;
+    forEachByShard(keys.size(), [&](size_t i) { return keys[i]; }, [&](Shard& shard, size_t i) {
+        if (shard.lookup(keys[i]) != nullptr) {
+            deleted += shard.delInternal(keys[i], lazy);
         }
+    });
+    return deleted;
+}
+
+size_t RedisDatabase::exists(const std::vector<std::string_view>& keys) {
+    size_t found = 0;
+    forEachByShard(keys.size(), [&](size_t i) { return keys[i]; }, [&](Shard& shard, size_t i) {
+        found += shard.lookup(keys[i]) != nullptr;
+    });
+    return found;
+}
+
+namespace {
+
+// INCRBYFLOAT results: fixed-point with trailing zeros dropped, so 3.0 + 1.5 stores "4.5"
+std::string formatLongDouble(long double v) {
+    char buf[5500];
+    int len = std::snprintf(buf, sizeof(buf), "%.17Lf", v);
+    if (len <= 0 || static_cast<size_t>(len) >= sizeof(buf)) return std::to_string(static_cast<double>(v));
+    std::string_view s(buf, len);
+    if (s.find('.') != std::string_view::npos) {
+        while (s.back() == '0') s.remove_suffix(1);
+        if (s.back() == '.') s.remove_suffix(1);
+    }
+    if (s == "-0") s = "0";
+    return std::string(s);
+}
+
+void checkStringLength(size_t length) {
+    if (length > RedisDatabase::MAX_STRING_SIZE) {
+        throw CommandError("Error: string exceeds maximum allowed size (512MB)");
+    }
+}
+
+} // namespace
+
+long long RedisDatabase::incrBy(std::string_view key, long long delta) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::STRING);
+    long long current = 0;
+    if (obj != nullptr && !obj->getInt(current)) {
+        throw CommandError("Error: value is not an integer or out of range");
+    }
+    long long result;
+    if (__builtin_add_overflow(current, delta, &result)) {
+        throw CommandError("Error: increment or decrement would overflow");
+    }
+    if (obj == nullptr) {
+        RedisObject created = RedisObject::makeString("");
+        created.setInt(result);
+        shard.insert(key, std::move(created));
+    } else {
+        shard.data_bytes -= obj->containerBytes();
+        obj->setInt(result); // stays INT: no allocation, however often it changes
+        shard.data_bytes += obj->containerBytes();
     }
+    shard.predictive_cache.recordAccess(key);
     return result;
 }
 
-std::string RedisDatabase::type(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key); // Remove expired key
-        return "none";
+std::string RedisDatabase::incrByFloat(std::string_view key, long double delta) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::STRING);
+    long double current = 0;
+    char buf[RedisObject::INT_STR_SIZE];
+    if (obj != nullptr && !RedisObject::parseLongDouble(obj->strView(buf), current)) {
+        throw CommandError("Error: value is not a valid float");
+    }
+    long double result = current + delta;
+    if (!std::isfinite(result)) {
+        throw CommandError("Error: increment would produce NaN or Infinity");
+    }
+    std::string text = formatLongDouble(result);
+    if (obj == nullptr) {
+        shard.insert(key, RedisObject::makeString(text));
+    } else {
+        shard.data_bytes -= obj->containerBytes();
+        obj->setString(text);
+        shard.data_bytes += obj->containerBytes();
     }
-    
-    // An access to check type also updates recency/frequency
-    if (predictive_cache.contains(key) || kv_store.count(key) || list_store.count(key) || hash_store.count(key)) {
-        predictive_cache.recordAccess(key); 
+    shard.predictive_cache.recordAccess(key);
+    return text;
+}
+
+size_t RedisDatabase::append(std::string_view key, std::string_view value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::STRING);
+    if (obj == nullptr) {
+        shard.insert(key, RedisObject::makeString(value));
+        shard.predictive_cache.recordAccess(key);
+        return value.size();
+    }
+    char buf[RedisObject::INT_STR_SIZE];
+    std::string_view current = obj->strView(buf);
+    size_t length = current.size() + value.size();
+    checkStringLength(length);
+    shard.data_bytes -= obj->containerBytes();
+    if (obj->encoding != ObjectEncoding::RAW && length <= EmbeddedString::CAPACITY) {
+        char joined[EmbeddedString::CAPACITY];
+        std::memcpy(joined, current.data(), current.size());
+        std::memcpy(joined + current.size(), value.data(), value.size());
+        obj->setString(std::string_view(joined, length)); // still short: stays EMBSTR/INT
+    } else {
+        // std::string grows geometrically, so repeated APPENDs are amortized O(1)
+        obj->rawString().append(value.data(), value.size());
+    }
+    shard.data_bytes += obj->containerBytes();
+    shard.predictive_cache.recordAccess(key);
+    return length;
+}
+
+size_t RedisDatabase::setRange(std::string_view key, size_t offset, std::string_view value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::STRING);
+    char buf[RedisObject::INT_STR_SIZE];
+    size_t current = obj != nullptr ? obj->strView(buf).size() : 0;
+    if (value.empty()) {
+        return current; // nothing to write, and a missing key is not created
+    }
+    checkStringLength(offset + value.size());
+    if (obj == nullptr) {
+        obj = &shard.insert(key, RedisObject::makeString(""));
+    }
+    shard.data_bytes -= obj->containerBytes();
+    std::string& s = obj->rawString();
+    if (s.size() < offset + value.size()) {
+        s.resize(offset + value.size(), '\0');
+    }
+    s.replace(offset, value.size(), value.data(), value.size());
+    if (s.size() <= EmbeddedString::CAPACITY) {
+        obj->setString(std::string(s)); // back to EMBSTR/INT once short again
+    }
+    shard.data_bytes += obj->containerBytes();
+    shard.predictive_cache.recordAccess(key);
+    return std::max(current, offset + value.size());
+}
+
+std::string RedisDatabase::getRange(std::string_view key, long long start, long long end) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::STRING);
+    if (obj == nullptr) {
+        return std::string();
+    }
+    shard.predictive_cache.recordAccess(key);
+    char buf[RedisObject::INT_STR_SIZE];
+    std::string_view s = obj->strView(buf);
+    long long len = static_cast<long long>(s.size());
+    if (start < 0) start = std::max(len + start, 0LL);
+    if (end < 0) end = len + end;
+    end = std::min(end, len - 1);
+    if (len == 0 || end < 0 || start > end) {
+        return std::string();
+    }
+    return std::string(s.substr(start, end - start + 1)); // copies only the slice
+}
+
+size_t RedisDatabase::strLen(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::STRING);
+    if (obj == nullptr) {
+        return 0;
     }
+    shard.predictive_cache.recordAccess(key);
+    char buf[RedisObject::INT_STR_SIZE];
+    return obj->strView(buf).size();
+}
 
+std::vector<std::string> RedisDatabase::keys(std::string_view pattern) {
+    std::vector<std::string> result;
+    bool all = pattern == "*";
+    for (Shard& shard : shards) {
+        ShardGuard guard(*this, shard);
+        long long now = currentTimeMs();
+        // Filter out expired keys while collecting; they are dropped afterwards
+        std::vector<std::string> expired;
+        shard.keyspace.forEach([&](const std::string& key, const RedisObject& obj) {
+            if (obj.isExpiredAt(now)) {
+                expired.push_back(key);
+            } else if (all || stringMatch(pattern, key)) {
+                result.push_back(key);
+            }
+        });
+        for (const std::string& key : expired) {
+            shard.delInternal(key, true); // Remove expired key found during KEYS command
+        }
+        shard.expired_keys.fetch_add(expired.size(), std::memory_order_relaxed);
+    }
+    return result;
+}
+
+// The cursor holds the shard in its low SHARD_BITS and that shard's Dict cursor above
+// them, so the shards are scanned one after the other. Like Redis, a call stops after
+// visiting 10 * count home groups even if few of them matched, so work per call stays
+// bounded however sparse the matches.
+uint64_t RedisDatabase::scan(uint64_t cursor, size_t count, std::string_view pattern, std::optional<ObjectType> type,
+                             std::vector<std::string>& keys) {
+    size_t index = cursor & (SHARD_COUNT - 1);
+    uint64_t shard_cursor = cursor >> SHARD_BITS;
+    bool all = pattern == "*";
+    size_t budget = count > std::numeric_limits<size_t>::max() / 10 ? count : count * 10;
+    std::vector<std::string> expired;
+    while (true) {
+        Shard& shard = shards[index];
+        {
+            ShardGuard guard(*this, shard);
+            long long now = currentTimeMs();
+            do {
+                shard_cursor = shard.keyspace.scan(shard_cursor, [&](const std::string& key, const RedisObject& obj) {
+                    if (obj.isExpiredAt(now)) {
+                        expired.push_back(key);
+                    } else if ((!type || obj.type == *type) && (all || stringMatch(pattern, key))) {
+                        keys.push_back(key);
+                    }
+                });
+            } while (shard_cursor != 0 && --budget > 0 && keys.size() < count);
+            for (const std::string& key : expired) {
+                shard.delInternal(key, true);
+            }
+            shard.expired_keys.fetch_add(expired.size(), std::memory_order_relaxed);
+            expired.clear();
+        }
+        if (shard_cursor != 0) {
+            break; // out of budget, or enough keys, partway through this shard
+        }
+        if (++index == SHARD_COUNT) {
+            return 0; // every shard done
+        }
+        if (budget == 0 || --budget == 0 || keys.size() >= count) {
+            break;
+        }
+    }
+    return (shard_cursor << SHARD_BITS) | index;
+}
 
-    if (kv_store.count(key)) {
-        return "string";
+uint64_t RedisDatabase::hscan(std::string_view key, uint64_t cursor, size_t count, std::string_view pattern,
+                              std::vector<std::pair<std::string, std::string>>& fields) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::HASH);
+    if (obj == nullptr) {
+        return 0;
     }
-    if (list_store.count(key)) {
-        return "list";
+    shard.predictive_cache.recordAccess(key);
+    bool all = pattern == "*";
+    auto add = [&](std::string_view field, std::string_view value) {
+        if (all || stringMatch(pattern, field)) {
+            fields.emplace_back(std::string(field), std::string(value));
+        }
+    };
+    if (obj->encoding == ObjectEncoding::LISTPACK) {
+        obj->packedHash().forEach(add); // small by construction
+        return 0;
     }
-    if (hash_store.count(key)) {
-        return "hash";
+    size_t budget = count > std::numeric_limits<size_t>::max() / 10 ? count : count * 10;
+    do {
+        cursor = obj->hash().scan(cursor, add);
+    } while (cursor != 0 && --budget > 0 && fields.size() < count);
+    return cursor;
+}
+
+std::string RedisDatabase::type(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookup(key);
+    if (obj == nullptr) {
+        return "none";
+    }
+    // An access to check type also updates recency/frequency
+    shard.predictive_cache.recordAccess(key);
+    return obj->typeName();
+}
+
+bool RedisDatabase::objectEncoding(std::string_view key, std::string& encoding) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookup(key);
+    if (obj == nullptr) {
+        return false;
     }
-    return "none";
+    encoding = obj->encodingName(); // introspection only: not an access
+    return true;
 }
 
-bool RedisDatabase::del(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    return delInternal(key); // Use internal helper for deletion
+bool RedisDatabase::del(std::string_view key, bool lazy) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    if (shard.lookup(key) == nullptr) {
+        return false; // Missing or already expired
+    }
+    return shard.delInternal(key, lazy); // Use internal helper for deletion
 }
 
-bool RedisDatabase::expire(const std::string& key, int seconds) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    // Check if the key exists in any store or is tracked by APC (could have been expired already but still in meta_store)
-    if (!predictive_cache.contains(key) && !kv_store.count(key) && !list_store.count(key) && !hash_store.count(key)) {
+bool RedisDatabase::expireAt(std::string_view key, long long deadline_ms) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookup(key);
+    if (obj == nullptr) {
         return false; // Key doesn't exist to set TTL on
     }
 
-    if (seconds > 0) {
-        predictive_cache.setTTL(key, static_cast<double>(seconds));
-        predictive_cache.recordAccess(key); // Setting TTL also counts as an access
-    } else { // EXPIRE key 0 means remove TTL or expire immediately
-        predictive_cache.setTTL(key, 0); // Effectively marks for immediate eviction/removal in APC logic
-        delInternal(key); // Immediately delete it from actual stores
+    long long now = currentTimeMs();
+    if (deadline_ms > now) {
+        shard.setExpire(key, *obj, deadline_ms);
+        shard.predictive_cache.setTTL(key, (deadline_ms - now) / 1000.0);
+        shard.predictive_cache.recordAccess(key); // Setting TTL also counts as an access
+    } else { // A deadline that already passed (e.g. EXPIRE key 0) means expire immediately
+        shard.delInternal(key, true); // Immediately delete it from the keyspace
     }
     return true;
 }
 
-bool RedisDatabase::rename(const std::string& oldKey, const std::string& newKey) {
-    std::lock_guard<std::mutex> lock(db_mutex);
+long long RedisDatabase::pttl(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookup(key);
+    if (obj == nullptr) {
+        return -2;
+    }
+    if (!obj->hasExpire()) {
+        return -1;
+    }
+    // lookup() already dropped the key if its deadline passed, so this is positive
+    return std::max(1LL, obj->expire_at_ms - currentTimeMs());
+}
 
-    // Check for expiration of oldKey
-    if (isExpired(oldKey)) {
-        delInternal(oldKey);
-        return false; // Cannot rename an expired key
+bool RedisDatabase::persist(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookup(key);
+    if (obj == nullptr || !obj->hasExpire()) {
+        return false;
     }
+    obj->expire_at_ms = 0; // Its expiry index entry is now stale and will be skipped
+    shard.predictive_cache.setTTL(key, 0);
+    shard.predictive_cache.recordAccess(key);
+    return true;
+}
+
+bool RedisDatabase::rename(std::string_view oldKey_view, std::string_view newKey_view) {
+    const std::string oldKey(oldKey_view), newKey(newKey_view);
+    size_t srcIndex = shardIndex(oldKey);
+    size_t dstIndex = shardIndex(newKey);
+    Shard& src = shards[srcIndex];
+    Shard& dst = shards[dstIndex];
+
+    // Both shards stay locked, and are published on every return path (lookup() may
+    // have expired oldKey).
+    MultiShardGuard guard(*this, {srcIndex, dstIndex});
 
-    // If newKey already exists, it should be deleted first (Redis behavior)
-    if (kv_store.count(newKey) || list_store.count(newKey) || hash_store.count(newKey)) {
-        delInternal(newKey);
+    if (src.lookup(oldKey) == nullptr) {
+        return false; // Missing or expired key cannot be renamed
     }
+    if (oldKey == newKey) {
+        return true;
+    }
+
+    // If newKey already exists, it is overwritten (Redis behavior)
+    dst.delInternal(newKey, true);
 
-    bool found = false;
-    KeyStats oldStats; // To temporarily hold stats if oldKey has APC data
+    // Remove old key's metadata from APC, holding on to it if it had any
+    std::optional<KeyStats> oldStats = src.predictive_cache.takeStats(oldKey);
 
-    if (predictive_cache.contains(oldKey)) {
-        oldStats = predictive_cache.meta_store[oldKey];
-        predictive_cache.removeKey(oldKey); // Remove old key's metadata from APC
+    // Move the object under its new name; list/hash payloads are not copied
+    RedisObject obj = std::move(*src.keyspace.take(oldKey));
+    size_t objBytes = obj.memoryUsage();
+    src.data_bytes -= stringHeapBytes(oldKey.size()) + objBytes;
+    dst.data_bytes += stringHeapBytes(newKey.size()) + objBytes;
+    RedisObject& moved = *dst.keyspace.emplace(newKey, std::move(obj)).first;
+    if (moved.hasExpire()) {
+        dst.setExpire(newKey, moved, moved.expire_at_ms); // The TTL travels with the value
     }
 
-    // Handle string keys
-    auto itKv = kv_store.find(oldKey);
-    if (itKv != kv_store.end()) {
-        kv_store[newKey] = itKv->second;
-        kv_store.erase(itKv);
-        found = true;
+    // If oldKey had APC stats, transfer them to newKey
+    if (oldStats) {
+        dst.predictive_cache.restoreStats(newKey, *oldStats); // Also recalculates the score
     }
+    dst.predictive_cache.recordAccess(newKey); // Rename itself is an access to newKey
+    return true;
+}
 
-    // Handle list keys
-    auto itList = list_store.find(oldKey);
-    if (itList != list_store.end()) {
-        list_store[newKey] = itList->second;
-        list_store.erase(itList);
-        found = true;
+// List operations. A list's containerBytes() covers its elements too, so every change
+// is accounted by taking it before and after.
+std::vector<std::string> RedisDatabase::lget(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::LIST);
+    if (obj == nullptr) {
+        return {};
     }
+    shard.predictive_cache.recordAccess(key);
+    std::vector<std::string> elements;
+    elements.reserve(obj->list().size());
+    obj->list().forEach([&elements](std::string_view e) { elements.emplace_back(e); });
+    return elements;
+}
 
-    // Handle hash keys
-    auto itHash = hash_store.find(oldKey);
-    if (itHash != hash_store.end()) {
-        hash_store[newKey] = itHash->second;
-        hash_store.erase(itHash);
-        found = true;
+ssize_t RedisDatabase::llen(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::LIST);
+    if (obj == nullptr) {
+        return 0;
     }
+    shard.predictive_cache.recordAccess(key);
+    return obj->list().size();
+}
 
-    if (found) {
-        // If oldKey had APC stats, transfer them to newKey
-        predictive_cache.recordAccess(newKey); // Ensures newKey is in meta_store
-        if (oldStats.access_count > 0) { // Check if oldStats was actually populated
-            predictive_cache.meta_store[newKey].access_count = oldStats.access_count;
-            predictive_cache.meta_store[newKey].last_access = oldStats.last_access;
-            predictive_cache.meta_store[newKey].ttl_initial_seconds = oldStats.ttl_initial_seconds;
-            predictive_cache.meta_store[newKey].ttl_set_time = oldStats.ttl_set_time;
-        }
-        predictive_cache.updateScore(newKey); // Recalculate score for new key with copied stats
-        predictive_cache.recordAccess(newKey); // Rename itself is an access to newKey
+void RedisDatabase::lpush(std::string_view key, std::string_view value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    // An expired key is dropped by the lookup, so LPUSH on it creates a new list
+    RedisObject& obj = shard.lookupOrCreate(key, ObjectType::LIST);
+    shard.data_bytes -= obj.containerBytes();
+    obj.list().pushFront(value);
+    shard.data_bytes += obj.containerBytes();
+    shard.predictive_cache.recordAccess(key);
+}
+
+void RedisDatabase::rpush(std::string_view key, std::string_view value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject& obj = shard.lookupOrCreate(key, ObjectType::LIST);
+    shard.data_bytes -= obj.containerBytes();
+    obj.list().pushBack(value);
+    shard.data_bytes += obj.containerBytes();
+    shard.predictive_cache.recordAccess(key);
+}
+
+bool RedisDatabase::rpop(std::string_view key, std::string& value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::LIST);
+    if (obj == nullptr || obj->list().empty()) {
+        return false;
     }
-    return found;
+    shard.predictive_cache.recordAccess(key);
+    shard.data_bytes -= obj->containerBytes();
+    obj->list().popBack(value);
+    shard.data_bytes += obj->containerBytes();
+    if (obj->list().empty()) { // If list becomes empty, delete its entry (like Redis)
+        shard.delInternal(key);
+    }
+    return true;
 }
 
-// List operations
-std::vector<std::string> RedisDatabase::lget(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
-        return {};
+bool RedisDatabase::lpop(std::string_view key, std::string& value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::LIST);
+    if (obj == nullptr || obj->list().empty()) {
+        return false;
     }
-    auto it = list_store.find(key);
-    if (it != list_store.end()) {
-        predictive_cache.recordAccess(key);
-        return it->second;
+    shard.predictive_cache.recordAccess(key);
+    shard.data_bytes -= obj->containerBytes();
+    obj->list().popFront(value);
+    shard.data_bytes += obj->containerBytes();
+    if (obj->list().empty()) { // If list becomes empty, delete its entry
+        shard.delInternal(key);
     }
-    return {};
+    return true;
 }
 
-ssize_t RedisDatabase::llen(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
+int RedisDatabase::lrem(std::string_view key, int count, std::string_view value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::LIST);
+    if (obj == nullptr) {
         return 0;
     }
-    auto it = list_store.find(key);
-    if (it != list_store.end()) {
-        predictive_cache.recordAccess(key);
-        return it->second.size();
+    // count > 0 removes from head to tail, count < 0 from tail to head, 0 removes all
+    shard.data_bytes -= obj->containerBytes();
+    int removed = static_cast<int>(obj->list().removeMatching(value, count));
+    shard.data_bytes += obj->containerBytes();
+
+    if (removed > 0) {
+        shard.predictive_cache.recordAccess(key);
+        if (obj->list().empty()) {
+            shard.delInternal(key); // If list becomes empty, delete its entry
+        }
     }
-    return 0;
+    return removed;
 }
 
-void RedisDatabase::lpush(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    // If expired, remove first (LPUSH on an expired key creates a new key)
-    if (isExpired(key)) {
-        delInternal(key);
+bool RedisDatabase::lindex(std::string_view key, int index, std::string& value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::LIST);
+    if (obj == nullptr) {
+        return false;
     }
-    list_store[key].insert(list_store[key].begin(), value);
-    predictive_cache.recordAccess(key);
-    checkAndEvict();
+    const auto& lst = obj->list();
+    long long pos = index < 0 ? static_cast<long long>(lst.size()) + index : index;
+    std::string_view element;
+    if (pos < 0 || !lst.at(static_cast<size_t>(pos), element)) {
+        return false;
+    }
+    shard.predictive_cache.recordAccess(key);
+    value.assign(element);
+    return true;
 }
 
-void RedisDatabase::rpush(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    // If expired, remove first
-    if (isExpired(key)) {
-        delInternal(key);
+bool RedisDatabase::lset(std::string_view key, int index, std::string_view value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::LIST);
+    if (obj == nullptr) {
+        return false;
+    }
+    auto& lst = obj->list();
+    long long pos = index < 0 ? static_cast<long long>(lst.size()) + index : index;
+    if (pos < 0 || pos >= static_cast<long long>(lst.size())) {
+        return false;
     }
-    list_store[key].push_back(value);
-    predictive_cache.recordAccess(key);
-    checkAndEvict();
+    shard.data_bytes -= obj->containerBytes();
+    lst.set(static_cast<size_t>(pos), value);
+    shard.data_bytes += obj->containerBytes();
+    shard.predictive_cache.recordAccess(key);
+    return true;
 }
 
-bool RedisDatabase::rpop(const std::string& key, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
+// Hash operations
+size_t RedisDatabase::hset(std::string_view key,
+                           const std::vector<std::pair<std::string_view, std::string_view>>& fieldValues) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    // An expired key is dropped by the lookup, so HSET on it creates a new hash
+    RedisObject& obj = shard.lookupOrCreate(key, ObjectType::HASH);
+    const ListpackLimits limits = hashLimits();
+    size_t added = 0;
+    for (const auto& pair : fieldValues) {
+        added += shard.hashSet(obj, pair.first, pair.second, limits) ? 1 : 0;
+    }
+    shard.predictive_cache.recordAccess(key);
+    return added;
+}
+
+bool RedisDatabase::hget(std::string_view key, std::string_view field, std::string& value) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::HASH);
+    if (obj == nullptr) {
         return false;
     }
-    auto it = list_store.find(key);
-    if (it != list_store.end() && !it->second.empty()) {
-        predictive_cache.recordAccess(key);
-        value = it->second.back();
-        it->second.pop_back();
-        if (it->second.empty()) { // If list becomes empty, delete its entry (like Redis)
-            delInternal(key);
-        }
-        return true;
+    std::string_view found;
+    if (!obj->hashGet(field, found)) {
+        return false;
     }
-    return false;
+    shard.predictive_cache.recordAccess(key);
+    value.assign(found);
+    return true;
 }
 
-bool RedisDatabase::lpop(const std::string& key, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
+bool RedisDatabase::hexists(std::string_view key, std::string_view field) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::HASH);
+    if (obj == nullptr) {
         return false;
     }
-    auto it = list_store.find(key);
-    if (it != list_store.end() && !it->second.empty()) {
-        predictive_cache.recordAccess(key);
-        value = it->second.front();
-        it->second.erase(it->second.begin());
-        if (it->second.empty()) { // If list becomes empty, delete its entry
-            delInternal(key);
+    shard.predictive_cache.recordAccess(key);
+    std::string_view found;
+    return obj->hashGet(field, found);
+}
+
+size_t RedisDatabase::hdel(std::string_view key, const std::vector<std::string_view>& fields) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::HASH);
+    if (obj == nullptr) {
+        return 0;
+    }
+    shard.predictive_cache.recordAccess(key);
+    size_t erased = 0;
+    for (std::string_view field : fields) {
+        if (obj->encoding == ObjectEncoding::LISTPACK) {
+            shard.data_bytes -= obj->containerBytes();
+            erased += obj->packedHash().erase(field) ? 1 : 0;
+            shard.data_bytes += obj->containerBytes();
+        } else {
+            shard.data_bytes -= obj->memoryUsage();
+            erased += obj->hashTableErase(field) ? 1 : 0;
+            shard.data_bytes += obj->memoryUsage();
         }
-        return true;
     }
-    return false;
+    if (obj->hashSize() == 0) { // If hash becomes empty, delete its entry
+        shard.delInternal(key);
+    }
+    return erased;
 }
 
-int RedisDatabase::lrem(const std::string& key, int count, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
-        return 0;
+std::vector<std::pair<std::string, std::string>> RedisDatabase::hgetall(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    std::vector<std::pair<std::string, std::string>> pairs;
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::HASH);
+    if (obj == nullptr) {
+        return pairs;
+    }
+    shard.predictive_cache.recordAccess(key);
+    pairs.reserve(obj->hashSize());
+    obj->hashForEach([&pairs](std::string_view field, std::string_view value) {
+        pairs.emplace_back(field, value);
+    });
+    return pairs;
+}
+
+std::vector<std::string> RedisDatabase::hkeys(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    std::vector<std::string> fields;
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::HASH);
+    if (obj == nullptr) {
+        return fields;
     }
-    int removed = 0;
-    auto it = list_store.find(key);
-    if (it == list_store.end()) {
+    shard.predictive_cache.recordAccess(key);
+    fields.reserve(obj->hashSize());
+    obj->hashForEach([&fields](std::string_view field, std::string_view) { fields.emplace_back(field); });
+    return fields;
+}
+
+std::vector<std::string> RedisDatabase::hvals(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    std::vector<std::string> values;
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::HASH);
+    if (obj == nullptr) {
+        return values;
+    }
+    shard.predictive_cache.recordAccess(key);
+    values.reserve(obj->hashSize());
+    obj->hashForEach([&values](std::string_view, std::string_view value) { values.emplace_back(value); });
+    return values;
+}
+
+ssize_t RedisDatabase::hlen(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::HASH);
+    if (obj == nullptr) {
         return 0;
     }
-    auto& lst = it->second;
-
-    if (count == 0) {
-        auto new_end = std::remove(lst.begin(), lst.end(), value);
-        removed = std::distance(new_end, lst.end());
-        lst.erase(new_end, lst.end());
-    } else if (count > 0) {
-        for (auto iter = lst.begin(); iter != lst.end() && removed < count;) {
-            if (*iter == value) {
-                iter = lst.erase(iter);
-                ++removed;
-            } else {
-                ++iter;
-            }
+    shard.predictive_cache.recordAccess(key);
+    return obj->hashSize();
+}
+
+bool RedisDatabase::hmset(std::string_view key_view, const std::vector<std::pair<std::string_view, std::string_view>>& fieldValues) {
+    hset(key_view, fieldValues); // HMSET is HSET replying OK instead of a count
+    return true;
+}
+
+// Sorted set operations
+size_t RedisDatabase::zadd(std::string_view key, const std::vector<std::pair<double, std::string_view>>& members,
+                           int flags, size_t& updated) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    updated = 0;
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::ZSET);
+    if (obj == nullptr) {
+        if (flags & ZADD_XX) {
+            return 0; // nothing to update
         }
-    } else { // count < 0, remove from tail to head
-        for (auto riter = lst.rbegin(); riter != lst.rend() && removed < (-count);) {
-            if (*riter == value) {
-                auto fwditerator = riter.base();
-                --fwditerator;
-                fwditerator = lst.erase(fwditerator);
-                ++removed;
-                riter = std::reverse_iterator<std::vector<std::string>::iterator>(fwditerator);
-            } else {
-                ++riter;
+        obj = &shard.insert(key, RedisObject::makeZset());
+    }
+    shard.predictive_cache.recordAccess(key);
+    const ListpackLimits limits = zsetLimits();
+    size_t added = 0;
+    for (const auto& [score, member] : members) {
+        double current;
+        if (obj->zsetScore(member, current)) {
+            if ((flags & ZADD_NX) || score == current || ((flags & ZADD_GT) && score < current) ||
+                ((flags & ZADD_LT) && score > current)) {
+                continue;
             }
+            ++updated;
+        } else if (flags & ZADD_XX) {
+            continue;
+        } else {
+            ++added;
         }
+        shard.zsetSet(*obj, member, score, limits);
     }
-
-    if (removed > 0) {
-        predictive_cache.recordAccess(key);
-        if (lst.empty()) {
-            delInternal(key); // If list becomes empty, delete its entry
-        }
+    if (obj->zsetSize() == 0) {
+        shard.delInternal(key);
     }
-    return removed;
+    return added;
 }
 
-bool RedisDatabase::lindex(const std::string& key, int index, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
+bool RedisDatabase::zincrBy(std::string_view key, std::string_view member, double delta, int flags, double& score) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::ZSET);
+    double current = 0;
+    bool exists = obj != nullptr && obj->zsetScore(member, current);
+    if (exists ? (flags & ZADD_NX) : (flags & ZADD_XX)) {
         return false;
     }
-    auto it = list_store.find(key);
-    if (it == list_store.end()) {
+    double result = current + delta;
+    if (std::isnan(result)) {
+        throw CommandError("Error: resulting score is not a number (NaN)");
+    }
+    if (exists && (((flags & ZADD_GT) && !(result > current)) || ((flags & ZADD_LT) && !(result < current)))) {
         return false;
     }
-    const auto& lst = it->second;
-    if (index < 0) {
-        index = lst.size() + index;
+    if (obj == nullptr) {
+        obj = &shard.insert(key, RedisObject::makeZset());
     }
-    if (index < 0 || index >= static_cast<int>(lst.size())) {
-        return false;
+    shard.predictive_cache.recordAccess(key);
+    if (!exists || result != current) {
+        shard.zsetSet(*obj, member, result, zsetLimits());
     }
-    predictive_cache.recordAccess(key);
-    value = lst[index];
+    score = result;
     return true;
 }
 
-bool RedisDatabase::lset(const std::string& key, int index, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
+bool RedisDatabase::zscore(std::string_view key, std::string_view member, double& score) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::ZSET);
+    if (obj == nullptr) {
         return false;
     }
-    auto it = list_store.find(key);
-    if (it == list_store.end()) {
-        return false;
+    shard.predictive_cache.recordAccess(key);
+    return obj->zsetScore(member, score);
+}
+
+size_t RedisDatabase::zrem(std::string_view key, const std::vector<std::string_view>& members) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::ZSET);
+    if (obj == nullptr) {
+        return 0;
     }
-    auto& lst = it->second;
-    if (index < 0) {
-        index = lst.size() + index;
+    shard.predictive_cache.recordAccess(key);
+    size_t removed = 0;
+    for (std::string_view member : members) {
+        removed += shard.zsetErase(*obj, member) ? 1 : 0;
     }
-    if (index < 0 || index >= static_cast<int>(lst.size())) {
+    if (obj->zsetSize() == 0) { // If the set becomes empty, delete its entry
+        shard.delInternal(key);
+    }
+    return removed;
+}
+
+size_t RedisDatabase::zcard(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::ZSET);
+    if (obj == nullptr) {
+        return 0;
+    }
+    shard.predictive_cache.recordAccess(key);
+    return obj->zsetSize();
+}
+
+bool RedisDatabase::zrank(std::string_view key, std::string_view member, bool reverse, size_t& rank) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::ZSET);
+    if (obj == nullptr) {
+        return false;
+    }
+    shard.predictive_cache.recordAccess(key);
+    if (!obj->zsetRank(member, rank)) {
         return false;
     }
-    lst[index] = value;
-    predictive_cache.recordAccess(key);
+    if (reverse) {
+        rank = obj->zsetSize() - 1 - rank;
+    }
     return true;
 }
 
-// Hash operations
-bool RedisDatabase::hset(const std::string& key, const std::string& field, const std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    // If expired, remove first (HSET on an expired key creates a new key)
-    if (isExpired(key)) {
-        delInternal(key);
-    }
-    hash_store[key][field] = value;
-    predictive_cache.recordAccess(key);
-    checkAndEvict();
-    return true;
+std::vector<std::pair<std::string, double>> RedisDatabase::zrange(std::string_view key, long long start,
+                                                                  long long stop, bool reverse) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    std::vector<std::pair<std::string, double>> result;
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::ZSET);
+    if (obj == nullptr) {
+        return result;
+    }
+    shard.predictive_cache.recordAccess(key);
+    long long len = static_cast<long long>(obj->zsetSize());
+    if (start < 0) start += len;
+    if (stop < 0) stop += len;
+    if (start < 0) start = 0;
+    if (stop >= len) stop = len - 1;
+    if (start > stop) {
+        return result;
+    }
+    // Reverse ranks count down from the highest score
+    size_t first = reverse ? len - 1 - stop : start;
+    size_t last = reverse ? len - 1 - start : stop;
+    result.reserve(last - first + 1);
+    obj->zsetForRanks(first, last + 1, reverse, [&result](std::string_view member, double score) {
+        result.emplace_back(member, score);
+    });
+    return result;
 }
 
-bool RedisDatabase::hget(const std::string& key, const std::string& field, std::string& value) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
-        return false;
+// The members in range are the ranks between countBelow and countUpTo, so the offset is
+// skipped by rank instead of by walking past it.
+std::vector<std::pair<std::string, double>> RedisDatabase::zrangeByScore(std::string_view key,
+                                                                         const ScoreRange& range, bool reverse,
+                                                                         long long offset, long long count) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    std::vector<std::pair<std::string, double>> result;
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::ZSET);
+    if (obj == nullptr) {
+        return result;
+    }
+    shard.predictive_cache.recordAccess(key);
+    size_t lo = obj->zsetCountBelow(range);
+    size_t hi = obj->zsetCountUpTo(range);
+    if (offset < 0 || hi <= lo || static_cast<size_t>(offset) >= hi - lo) {
+        return result;
+    }
+    size_t n = hi - lo - offset;
+    if (count >= 0 && static_cast<size_t>(count) < n) {
+        n = count;
+    }
+    size_t first = reverse ? hi - offset - n : lo + offset;
+    result.reserve(n);
+    obj->zsetForRanks(first, first + n, reverse, [&result](std::string_view member, double score) {
+        result.emplace_back(member, score);
+    });
+    return result;
+}
+
+size_t RedisDatabase::zcount(std::string_view key, const ScoreRange& range) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::ZSET);
+    if (obj == nullptr) {
+        return 0;
     }
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        auto f = it->second.find(field);
-        if (f != it->second.end()) {
-            predictive_cache.recordAccess(key);
-            value = f->second;
-            return true;
-        }
+    shard.predictive_cache.recordAccess(key);
+    size_t lo = obj->zsetCountBelow(range);
+    size_t hi = obj->zsetCountUpTo(range);
+    return hi > lo ? hi - lo : 0;
+}
+
+// Set operations
+size_t RedisDatabase::sadd(std::string_view key, const std::vector<std::string_view>& members) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject& obj = shard.lookupOrCreate(key, ObjectType::SET);
+    shard.predictive_cache.recordAccess(key);
+    const size_t max_intset_entries = getSetMaxIntsetEntries();
+    size_t added = 0;
+    for (std::string_view member : members) {
+        added += shard.setAdd(obj, member, max_intset_entries) ? 1 : 0;
+    }
+    return added;
+}
+
+size_t RedisDatabase::srem(std::string_view key, const std::vector<std::string_view>& members) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::SET);
+    if (obj == nullptr) {
+        return 0;
     }
-    return false;
+    shard.predictive_cache.recordAccess(key);
+    size_t removed = 0;
+    for (std::string_view member : members) {
+        removed += shard.setRemove(*obj, member) ? 1 : 0;
+    }
+    if (obj->setSize() == 0) { // If the set becomes empty, delete its entry
+        shard.delInternal(key);
+    }
+    return removed;
 }
 
-bool RedisDatabase::hexists(const std::string& key, const std::string& field) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
+bool RedisDatabase::sismember(std::string_view key, std::string_view member) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::SET);
+    if (obj == nullptr) {
         return false;
     }
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        predictive_cache.recordAccess(key);
-        return it->second.count(field) > 0;
+    shard.predictive_cache.recordAccess(key);
+    return obj->setContains(member);
+}
+
+std::vector<bool> RedisDatabase::smismember(std::string_view key, const std::vector<std::string_view>& members) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    std::vector<bool> found(members.size(), false);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::SET);
+    if (obj == nullptr) {
+        return found;
+    }
+    shard.predictive_cache.recordAccess(key);
+    for (size_t i = 0; i < members.size(); ++i) {
+        found[i] = obj->setContains(members[i]);
     }
-    return false;
+    return found;
 }
 
-bool RedisDatabase::hdel(const std::string& key, const std::string& field) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
-        return false;
+size_t RedisDatabase::scard(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::SET);
+    if (obj == nullptr) {
+        return 0;
+    }
+    shard.predictive_cache.recordAccess(key);
+    return obj->setSize();
+}
+
+std::vector<std::string> RedisDatabase::smembers(std::string_view key) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    std::vector<std::string> members;
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::SET);
+    if (obj == nullptr) {
+        return members;
+    }
+    shard.predictive_cache.recordAccess(key);
+    members.reserve(obj->setSize());
+    obj->setForEach([&members](std::string_view member) { members.emplace_back(member); });
+    return members;
+}
+
+uint64_t RedisDatabase::sscan(std::string_view key, uint64_t cursor, size_t count, std::string_view pattern,
+                              std::vector<std::string>& members) {
+    Shard& shard = shardFor(key);
+    ShardGuard guard(*this, shard);
+    RedisObject* obj = shard.lookupTyped(key, ObjectType::SET);
+    if (obj == nullptr) {
+        return 0;
     }
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        predictive_cache.recordAccess(key);
-        bool erased = it->second.erase(field) > 0;
-        if (it->second.empty()) { // If hash becomes empty, delete its entry
-            delInternal(key);
+    shard.predictive_cache.recordAccess(key);
+    bool all = pattern == "*";
+    auto add = [&](std::string_view member) {
+        if (all || stringMatch(pattern, member)) {
+            members.emplace_back(member);
         }
-        return erased;
+    };
+    if (obj->encoding == ObjectEncoding::INTSET) {
+        obj->setForEach(add); // small by construction
+        return 0;
     }
-    return false;
+    size_t budget = count > std::numeric_limits<size_t>::max() / 10 ? count : count * 10;
+    do {
+        cursor = obj->set().scan(cursor, [&add](const std::string& member, std::monostate) { add(member); });
+    } while (cursor != 0 && --budget > 0 && members.size() < count);
+    return cursor;
 }
 
-std::unordered_map<std::string, std::string> RedisDatabase::hgetall(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
-        return {};
+std::vector<const RedisObject*> RedisDatabase::lookupSets(const std::vector<std::string_view>& keys) {
+    // Look every key up first: lookup() may expire a key or migrate slots of a rehashing
+    // keyspace, which would move objects already pointed to. The const finds after it
+    // touch nothing.
+    for (std::string_view key : keys) {
+        Shard& shard = shards[shardIndex(key)];
+        if (shard.lookupTyped(key, ObjectType::SET) != nullptr) {
+            shard.predictive_cache.recordAccess(key);
+        }
     }
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        predictive_cache.recordAccess(key);
-        return it->second;
+    std::vector<const RedisObject*> sets;
+    sets.reserve(keys.size());
+    for (std::string_view key_view : keys) {
+        const Dict<RedisObject>& keyspace = shards[shardIndex(key_view)].keyspace;
+        sets.push_back(keyspace.find(key_view));
     }
-    return {};
+    return sets;
 }
 
-std::vector<std::string> RedisDatabase::hkeys(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    std::vector<std::string> fields;
-    if (isExpired(key)) {
-        delInternal(key);
-        return fields;
-    }
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        predictive_cache.recordAccess(key);
-        for (const auto& pair : it->second) {
-            fields.push_back(pair.first);
+namespace {
+
+// Outcome of set algebra: sorted integers when every input was an intset, else strings.
+struct SetResult {
+    bool integers = false;
+    std::vector<int64_t> ints;
+    std::vector<std::string> members;
+    size_t size() const { return integers ? ints.size() : members.size(); }
+};
+
+// Combines intsets with the merge kernels, on arrays of T: int32_t unless some input
+// is wide, so narrow sets are merged four values per instruction.
+template <typename T>
+std::vector<T> combineIntsets(SetOperation op, std::vector<const Intset*> sets) {
+    if (op != SetOperation::DIFF) {
+        // Smallest first: an intersection can only shrink from there, and a union
+        // copies the large sets the fewest times
+        std::sort(sets.begin(), sets.end(), [](const Intset* a, const Intset* b) { return a->size() < b->size(); });
+    }
+    std::vector<T> result, next, scratch;
+    const T* first = sets[0]->data(scratch);
+    result.assign(first, first + sets[0]->size());
+    for (size_t i = 1; i < sets.size() && (!result.empty() || op == SetOperation::UNION); ++i) {
+        const T* other = sets[i]->data(scratch);
+        size_t n = sets[i]->size();
+        switch (op) {
+            case SetOperation::INTER:
+                next.resize(std::min(result.size(), n));
+                next.resize(intersectSorted(result.data(), result.size(), other, n, next.data()));
+                break;
+            case SetOperation::UNION:
+                next.resize(result.size() + n);
+                next.resize(unionSorted(result.data(), result.size(), other, n, next.data()));
+                break;
+            case SetOperation::DIFF:
+                next.resize(result.size());
+                next.resize(differenceSorted(result.data(), result.size(), other, n, next.data()));
+                break;
         }
+        result.swap(next);
     }
-    return fields;
+    return result;
 }
 
-std::vector<std::string> RedisDatabase::hvals(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    std::vector<std::string> values;
-    if (isExpired(key)) {
-        delInternal(key);
-        return values;
-    }
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        predictive_cache.recordAccess(key);
-        for (const auto& pair : it->second) {
-            values.push_back(pair.second); // Corrected to push_back pair.second for values
+// Set algebra over sets (nullptr: a missing key, i.e. an empty set). An intersection
+// stops collecting once it has limit members (0: no limit).
+SetResult combineSets(SetOperation op, std::vector<const RedisObject*> sets, size_t limit = 0) {
+    SetResult result;
+    bool missing = std::find(sets.begin(), sets.end(), nullptr) != sets.end();
+    if ((op == SetOperation::INTER && missing) || (op == SetOperation::DIFF && sets[0] == nullptr)) {
+        return result; // empty intersection, or nothing to take a difference from
+    }
+    sets.erase(std::remove(sets.begin(), sets.end(), nullptr), sets.end());
+    if (sets.empty()) {
+        return result;
+    }
+    bool all_ints = true, wide = false;
+    for (const RedisObject* set : sets) {
+        all_ints = all_ints && set->encoding == ObjectEncoding::INTSET;
+        wide = wide || (set->encoding == ObjectEncoding::INTSET && set->intset().wide());
+    }
+    if (all_ints) {
+        std::vector<const Intset*> intsets;
+        for (const RedisObject* set : sets) {
+            intsets.push_back(&set->intset());
+        }
+        result.integers = true;
+        if (wide) {
+            result.ints = combineIntsets<int64_t>(op, intsets);
+        } else {
+            std::vector<int32_t> narrow = combineIntsets<int32_t>(op, intsets);
+            result.ints.assign(narrow.begin(), narrow.end());
+        }
+        return result;
+    }
+    switch (op) {
+        case SetOperation::INTER: {
+            // Walk the smallest set and probe the others, smallest (likeliest to miss) first
+            std::sort(sets.begin(), sets.end(), [](const RedisObject* a, const RedisObject* b) {
+                return a->setSize() < b->setSize();
+            });
+            sets[0]->setForEach([&](std::string_view member) {
+                if (limit != 0 && result.members.size() >= limit) return;
+                for (size_t i = 1; i < sets.size(); ++i) {
+                    if (!sets[i]->setContains(member)) return;
+                }
+                result.members.emplace_back(member);
+            });
+            break;
+        }
+        case SetOperation::UNION: {
+            std::unordered_set<std::string> members;
+            for (const RedisObject* set : sets) {
+                set->setForEach([&members](std::string_view member) { members.emplace(member); });
+            }
+            result.members.reserve(members.size());
+            for (auto it = members.begin(); it != members.end();) {
+                result.members.push_back(std::move(members.extract(it++).value()));
+            }
+            break;
         }
+        case SetOperation::DIFF:
+            sets[0]->setForEach([&](std::string_view member) {
+                for (size_t i = 1; i < sets.size(); ++i) {
+                    if (sets[i]->setContains(member)) return;
+                }
+                result.members.emplace_back(member);
+            });
+            break;
     }
-    return values;
+    return result;
+}
+
+std::string formatInt(int64_t v) {
+    char buf[RedisObject::INT_STR_SIZE];
+    auto res = std::to_chars(buf, buf + RedisObject::INT_STR_SIZE, v);
+    return std::string(buf, res.ptr - buf);
+}
+
+} // namespace
+
+std::vector<std::string> RedisDatabase::setOperation(SetOperation op, const std::vector<std::string_view>& keys) {
+    std::vector<size_t> indices;
+    for (std::string_view key : keys) {
+        indices.push_back(shardIndex(key));
+    }
+    MultiShardGuard guard(*this, std::move(indices));
+    SetResult result = combineSets(op, lookupSets(keys));
+    if (!result.integers) {
+        return std::move(result.members);
+    }
+    std::vector<std::string> members;
+    members.reserve(result.ints.size());
+    for (int64_t v : result.ints) {
+        members.push_back(formatInt(v));
+    }
+    return members;
 }
 
-ssize_t RedisDatabase::hlen(const std::string& key) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    if (isExpired(key)) {
-        delInternal(key);
+size_t RedisDatabase::setOperationStore(SetOperation op, std::string_view destination,
+                                        const std::vector<std::string_view>& keys) {
+    std::vector<size_t> indices;
+    for (std::string_view key : keys) {
+        indices.push_back(shardIndex(key));
+    }
+    indices.push_back(shardIndex(destination));
+    MultiShardGuard guard(*this, std::move(indices));
+    SetResult result = combineSets(op, lookupSets(keys)); // a copy: destination may be one of keys
+    Shard& shard = shardFor(destination);
+    shard.delInternal(destination, true);
+    if (result.size() == 0) {
         return 0;
     }
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        predictive_cache.recordAccess(key);
-        return it->second.size();
+    if (!result.integers && result.members.size() <= getSetMaxIntsetEntries()) {
+        // Integers read from hash sets still fit an intset, as they would if SADDed
+        long long v;
+        result.integers = std::all_of(result.members.begin(), result.members.end(), [&](const std::string& member) {
+            return RedisObject::parseCanonicalInt(member, v) && (result.ints.push_back(v), true);
+        });
+        if (result.integers) {
+            std::sort(result.ints.begin(), result.ints.end());
+            result.members.clear();
+        } else {
+            result.ints.clear();
+        }
+    }
+    RedisObject obj = RedisObject::makeSet();
+    if (result.integers && result.ints.size() <= getSetMaxIntsetEntries()) {
+        obj.intset().assignSorted(result.ints);
+    } else {
+        obj.convertSetToTable();
+        obj.set().reserve(result.size());
+        for (int64_t v : result.ints) {
+            obj.setTableAdd(formatInt(v));
+        }
+        for (const std::string& member : result.members) {
+            obj.setTableAdd(member);
+        }
     }
-    return 0;
+    shard.insert(destination, std::move(obj));
+    shard.predictive_cache.recordAccess(destination);
+    return result.size();
 }
 
-bool RedisDatabase::hmset(const std::string& key, const std::vector<std::pair<std::string, std::string>>& fieldValues) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    // If expired, remove first (HMSET on an expired key creates a new key)
-    if (isExpired(key)) {
-        delInternal(key);
-    }
-    for (const auto& pair : fieldValues) {
-        hash_store[key][pair.first] = pair.second;
-    }
-    predictive_cache.recordAccess(key);
-    checkAndEvict();
-    return true;
+size_t RedisDatabase::sinterCard(const std::vector<std::string_view>& keys, size_t limit) {
+    std::vector<size_t> indices;
+    for (std::string_view key : keys) {
+        indices.push_back(shardIndex(key));
+    }
+    MultiShardGuard guard(*this, std::move(indices));
+    size_t count = combineSets(SetOperation::INTER, lookupSets(keys), limit).size();
+    return limit != 0 ? std::min(count, limit) : count;
 }
 
 // Persistent: Dump /load the database from a file.
-bool RedisDatabase::dump(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(db_mutex);
-    std::ofstream ofs(filename, std::ios::binary); // open file in binary mode
-    if (!ofs) return false; // error opening file
+namespace {
+
+// Eviction metadata travels with wall-clock times: the steady clock restarts with the
+// process, so its time points mean nothing to the next one.
+void writeKeyStats(SnapshotWriter& writer, const KeyStats& stats, const RedisObject& obj,
+                   long long now_ms, std::chrono::steady_clock::time_point now) {
+    long long idle_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - stats.last_access).count();
+    long long ttl_ms = obj.hasExpire() ? std::llround(stats.ttl_initial_seconds * 1000) : 0;
+    writer.writeByte(SNAP_KEY_STATS);
+    writer.writeVarint(static_cast<uint64_t>(std::max(stats.access_count, 0)));
+    writer.writeVarint(static_cast<uint64_t>(std::max(now_ms - std::max(idle_ms, 0LL), 0LL)));
+    writer.writeVarint(static_cast<uint64_t>(std::max(ttl_ms, 0LL)));
+}
+
+// Turns a SNAP_KEY_STATS record back into stats for a key with the given deadline.
+KeyStats readKeyStats(uint64_t accesses, uint64_t last_access_ms, uint64_t ttl_ms, long long expire_at_ms,
+                      long long now_ms, std::chrono::steady_clock::time_point now) {
+    using std::chrono::milliseconds;
+    KeyStats stats;
+    stats.access_count = static_cast<int>(std::min<uint64_t>(accesses, std::numeric_limits<int>::max()));
+    // A last access in the future (clock stepped back since the save) counts as now
+    long long idle_ms = std::max(now_ms - static_cast<long long>(std::min<uint64_t>(last_access_ms, now_ms)), 0LL);
+    stats.last_access = now - milliseconds(idle_ms);
+    if (expire_at_ms > 0) {
+        long long remaining_ms = expire_at_ms - now_ms;
+        long long total_ms = std::max(static_cast<long long>(std::min<uint64_t>(ttl_ms, 1ULL << 62)), remaining_ms);
+        stats.ttl_initial_seconds = total_ms / 1000.0;
+        stats.ttl_set_time = now - milliseconds(total_ms - remaining_ms);
+    }
+    return stats;
+}
 
-    // Only dump non-expired keys
-    for (const auto& kv : kv_store) {
-        if (!isExpired(kv.first)) {
-            ofs << "K " << kv.first << " " << kv.second << "\\n";
+void writeObject(SnapshotWriter& writer, const std::string& key, const RedisObject& obj, const KeyStats* stats,
+                 long long now_ms, std::chrono::steady_clock::time_point now) {
+    if (obj.hasExpire()) {
+        writer.writeByte(SNAP_EXPIRE_MS);
+        writer.writeFixed64(static_cast<uint64_t>(obj.expire_at_ms));
+    }
+    if (stats) {
+        writeKeyStats(writer, *stats, obj, now_ms, now);
+    }
+    switch (obj.type) {
+        case ObjectType::STRING: {
+            writer.writeByte(SNAP_STRING);
+            writer.writeString(key);
+            char buf[RedisObject::INT_STR_SIZE];
+            writer.writeString(obj.strView(buf));
+            break;
         }
+        case ObjectType::LIST:
+            writer.writeByte(SNAP_LIST);
+            writer.writeString(key);
+            writer.writeVarint(obj.list().size());
+            obj.list().forEach([&writer](std::string_view item) { writer.writeString(item); });
+            break;
+        case ObjectType::HASH:
+            writer.writeByte(SNAP_HASH);
+            writer.writeString(key);
+            writer.writeVarint(obj.hashSize());
+            obj.hashForEach([&writer](std::string_view field, std::string_view value) {
+                writer.writeString(field);
+                writer.writeString(value);
+            });
+            break;
+        case ObjectType::SET:
+            writer.writeByte(SNAP_SET);
+            writer.writeString(key);
+            writer.writeVarint(obj.setSize());
+            obj.setForEach([&writer](std::string_view member) { writer.writeString(member); });
+            break;
+        case ObjectType::ZSET:
+            writer.writeByte(SNAP_ZSET);
+            writer.writeString(key);
+            writer.writeVarint(obj.zsetSize());
+            obj.zsetForEach([&writer](std::string_view member, double score) {
+                uint64_t bits;
+                std::memcpy(&bits, &score, sizeof(bits));
+                writer.writeString(member);
+                writer.writeFixed64(bits);
+            });
+            break;
     }
-    for (const auto& kv : list_store) {
-        if (!isExpired(kv.first)) {
-            ofs << "L " << kv.first;
-            for (const auto& item : kv.second) {
-                ofs << " " << item;
+}
+
+// Encoding limits in force while a snapshot section is decoded.
+struct LoadLimits {
+    RedisDatabase::ListpackLimits hash;
+    RedisDatabase::ListpackLimits zset;
+    size_t intset_entries;
+};
+
+// Reads the payload of a SNAP_STRING/LIST/HASH/ZSET/SET record into obj.
+// Values within their encoding's limits are rebuilt compact (listpack, intset).
+bool readObject(SnapshotReader& reader, uint8_t opcode, RedisObject& obj, const LoadLimits& limits) {
+    uint64_t count;
+    switch (opcode) {
+        case SNAP_STRING: {
+            std::string_view value;
+            if (!reader.readString(value)) return false;
+            obj = RedisObject::makeString(value);
+            return true;
+        }
+        case SNAP_LIST: {
+            if (!reader.readVarint(count)) return false;
+            obj = RedisObject::makeList();
+            RedisObject::List& list = obj.list();
+            std::string_view item;
+            for (uint64_t i = 0; i < count; ++i) {
+                if (!reader.readString(item)) return false;
+                list.pushBack(item);
+            }
+            return true;
+        }
+        case SNAP_HASH: {
+            if (!reader.readVarint(count)) return false;
+            obj = RedisObject::makeHash();
+            if (count > limits.hash.entries) {
+                obj.convertHashToTable();
+                obj.hash().reserve(std::min<uint64_t>(count, 1 << 16)); // count is untrusted until read
+            }
+            std::string_view field, value;
+            for (uint64_t i = 0; i < count; ++i) {
+                if (!reader.readString(field) || !reader.readString(value)) return false;
+                if (obj.encoding == ObjectEncoding::LISTPACK && !limits.hash.fits(field, value)) {
+                    obj.convertHashToTable();
+                }
+                if (obj.encoding == ObjectEncoding::LISTPACK) {
+                    obj.packedHash().set(field, value);
+                } else {
+                    obj.hashTableSet(field, value);
+                }
+            }
+            return true;
+        }
+        case SNAP_ZSET: {
+            if (!reader.readVarint(count)) return false;
+            obj = RedisObject::makeZset();
+            if (count > limits.zset.entries) {
+                obj.convertZsetToSkiplist();
+                obj.zset().reserve(std::min<uint64_t>(count, 1 << 16)); // count is untrusted until read
             }
-            ofs << "\\n";
+            std::string_view member, prev_member;
+            double score, prev_score = 0;
+            uint64_t bits;
+            for (uint64_t i = 0; i < count; ++i) {
+                if (!reader.readString(member) || !reader.readFixed64(bits)) return false;
+                std::memcpy(&score, &bits, sizeof(score));
+                if (std::isnan(score)) return false;
+                if (obj.encoding == ObjectEncoding::LISTPACK && member.size() > limits.zset.value) {
+                    obj.convertZsetToSkiplist();
+                }
+                if (obj.encoding == ObjectEncoding::LISTPACK) {
+                    // Members are saved in order, so each can simply be appended
+                    if (i > 0 && (prev_score > score || (prev_score == score && prev_member >= member))) {
+                        return false; // out of order or repeated: the file is damaged
+                    }
+                    char buf[sizeof(double)];
+                    obj.packedZset().append(member, RedisObject::packScore(score, buf));
+                } else {
+                    obj.zset().set(member, score);
+                }
+                prev_member = member;
+                prev_score = score;
+            }
+            return true;
         }
+        case SNAP_SET: {
+            if (!reader.readVarint(count)) return false;
+            obj = RedisObject::makeSet();
+            if (count > limits.intset_entries) {
+                obj.convertSetToTable();
+                obj.set().reserve(std::min<uint64_t>(count, 1 << 16)); // count is untrusted until read
+            }
+            std::string_view member;
+            long long v;
+            for (uint64_t i = 0; i < count; ++i) {
+                if (!reader.readString(member)) return false;
+                if (obj.encoding == ObjectEncoding::INTSET && !RedisObject::parseCanonicalInt(member, v)) {
+                    obj.convertSetToTable();
+                }
+                if (obj.encoding == ObjectEncoding::INTSET) {
+                    obj.intset().insert(v); // saved in ascending order, so this appends
+                } else {
+                    obj.setTableAdd(member);
+                }
+            }
+            return true;
+        }
+        default:
+            return false; // unknown record type
     }
-    for (const auto& kv : hash_store) {
-        if (!isExpired(kv.first)) {
-            ofs << "H " << kv.first;
-            for (const auto& field_val : kv.second) {
-                ofs << " " << field_val.first << " " << field_val.second;
+}
+
+} // namespace
+
+bool RedisDatabase::writeSnapshot(const std::string& filename, uint64_t& bytes) {
+    // Write to a temporary file and rename it over the old snapshot, so a crash or a
+    // full disk mid-save never leaves a truncated dump behind. The name is per process
+    // so a foreground save and a background child never share a file.
+    const std::string tmp = filename + ".tmp." + std::to_string(getpid());
+    FILE* file = std::fopen(tmp.c_str(), "wb");
+    if (!file) return false; // error opening file
+
+    SnapshotWriter writer(file);
+    writer.writeHeader();
+    long long now = currentTimeMs();
+    auto steady_now = std::chrono::steady_clock::now();
+    // One section per shard, so a loader can decode them in parallel
+    std::vector<SnapshotSection> sections;
+    sections.reserve(SHARD_COUNT);
+    for (Shard& shard : shards) {
+        sections.push_back({writer.bytesWritten(), shard.keyspace.size()});
+        shard.keyspace.forEach([&](const std::string& key, const RedisObject& obj) {
+            if (!obj.isExpiredAt(now)) { // Only dump non-expired keys
+                writeObject(writer, key, obj, shard.predictive_cache.peekStats(key), now, steady_now);
             }
-            ofs << "\\n";
+        });
+    }
+    writer.writeSectionIndex(sections);
+    bool ok = writer.finish();
+    bytes = writer.bytesWritten();
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool RedisDatabase::dump(const std::string& filename) {
+    {
+        // A foreground save supersedes a background child still writing an older snapshot
+        std::lock_guard<std::mutex> lock(save_mutex);
+        if (save_child > 0) {
+            kill(save_child, SIGUSR1);
         }
     }
-    // TODO: Consider dumping APC metadata for more robust persistence of scores/TTL
-    // For now, TTL is handled during load implicitly by setting it again if present.
+    auto started = std::chrono::steady_clock::now();
+    uint64_t bytes = 0;
+    bool ok;
+    {
+        auto locks = lockAllShards(); // consistent snapshot across shards
+        ok = writeSnapshot(filename, bytes);
+    }
+    recordSave(ok, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count(), bytes);
+    return ok;
+}
+
+bool RedisDatabase::bgsave(const std::string& filename) {
+    std::lock_guard<std::mutex> save_lock(save_mutex);
+    if (save_child > 0) {
+        return false; // one background save at a time
+    }
+    auto started = std::chrono::steady_clock::now();
+    pid_t pid = forkSnapshotChild([this, &filename] {
+        uint64_t bytes = 0;
+        return writeSnapshot(filename, bytes);
+    });
+    if (pid < 0) {
+        save_stats.last_ok = false;
+        return false;
+    }
+    save_stats.last_fork_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+    save_stats.in_progress = true;
+    save_child = pid;
+    std::thread([this, pid, started, filename] { reapSaveChild(pid, started, filename); }).detach();
     return true;
 }
 
+pid_t RedisDatabase::forkSnapshotChild(const std::function<bool()>& child_main) {
+    // Fork with every shard locked so no shard is mid-write in the child's copy.
+    // Commands stall only for the fork itself; after that the kernel copies pages
+    // lazily as the parent modifies them.
+    auto locks = lockAllShards();
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Child: only this thread exists, and the locks it inherited are never touched
+        // again. Leave without running destructors or atexit handlers, which belong to
+        // the parent.
+        signal(SIGINT, SIG_DFL);
+        _exit(child_main() ? 0 : 1);
+    }
+    return pid;
+}
+
+void RedisDatabase::forEachUnlocked(const std::function<void(const std::string&, const RedisObject&)>& fn) {
+    long long now = currentTimeMs();
+    for (Shard& shard : shards) {
+        shard.keyspace.forEach([&](const std::string& key, const RedisObject& obj) {
+            if (!obj.isExpiredAt(now)) {
+                fn(key, obj);
+            }
+        });
+    }
+}
+
+void RedisDatabase::reapSaveChild(pid_t pid, std::chrono::steady_clock::time_point started, const std::string& filename) {
+    // Wait for the child without reaping it: until it is reaped its pid cannot be
+    // reused, so dump() signalling save_child never reaches an unrelated process.
+    siginfo_t info{};
+    while (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) < 0 && errno == EINTR) {
+    }
+    {
+        std::lock_guard<std::mutex> lock(save_mutex);
+        save_child = -1;
+        save_stats.in_progress = false;
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    long long duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    bool cancelled = WIFSIGNALED(status) && WTERMSIG(status) == SIGUSR1; // superseded by dump()
+    if (!ok) {
+        // A killed child leaves its half-written temporary file behind
+        std::remove((filename + ".tmp." + std::to_string(pid)).c_str());
+    }
+    uint64_t bytes = 0;
+    struct stat st;
+    if (ok && stat(filename.c_str(), &st) == 0) {
+        bytes = static_cast<uint64_t>(st.st_size);
+    }
+    if (cancelled) {
+        std::cout << "Background saving cancelled\n";
+        return;
+    }
+    recordSave(ok, duration_ms, bytes);
+    if (ok) {
+        std::cout << "Background saving terminated with success: " << bytes << " bytes in " << duration_ms << " ms\n";
+    } else {
+        std::cerr << "Background saving error\n";
+    }
+}
+
+void RedisDatabase::recordSave(bool ok, long long duration_ms, uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(save_mutex);
+    save_stats.last_ok = ok;
+    save_stats.last_duration_ms = duration_ms;
+    if (ok) {
+        save_stats.last_save_time = currentTimeMs() / 1000;
+        save_stats.last_bytes = bytes;
+    }
+}
+
+RedisDatabase::SaveStats RedisDatabase::saveStats() {
+    std::lock_guard<std::mutex> lock(save_mutex);
+    return save_stats;
+}
+
 bool RedisDatabase::load(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(db_mutex);
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false; // error opening file
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+    madvise(mapping, size, MADV_WILLNEED);
+    const char* data = static_cast<const char*>(mapping);
+
+    if (size < sizeof(SNAPSHOT_MAGIC) || std::memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        munmap(mapping, size);
+        return loadLegacyText(filename); // dump written by an older version
+    }
+
+    // Clear existing data before loading
+    flushAll();
+
+    SnapshotLayout layout;
+    bool ok = parseSnapshotLayout(data, size, layout);
+    if (ok) {
+        // Sections are decoded by a pool of threads straight from the mapping, and the
+        // checksum is computed alongside on one more; a mismatch discards the result.
+        std::atomic<size_t> next_section{0};
+        std::atomic<bool> failed{false};
+        auto decode = [&] {
+            size_t i;
+            while (!failed.load(std::memory_order_relaxed) &&
+                   (i = next_section.fetch_add(1)) < layout.sections.size()) {
+                const SnapshotLayout::Range& section = layout.sections[i];
+                if (!loadSection(section.begin, section.end, section.keys)) {
+                    failed.store(true);
+                }
+            }
+        };
+        uint32_t crc = 0;
+        std::thread checksum([&] { crc = crc32c(0, data, layout.checksummed); });
+        size_t workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), layout.sections.size());
+        std::vector<std::thread> pool;
+        for (size_t i = 1; i < workers; ++i) {
+            pool.emplace_back(decode);
+        }
+        decode();
+        for (std::thread& t : pool) {
+            t.join();
+        }
+        checksum.join();
+        ok = !failed.load() && crc == layout.stored_crc;
+    }
+    munmap(mapping, size);
+    if (!ok) {
+        // Never run on half a dataset: a damaged snapshot loads nothing
+        std::cerr << "Snapshot " << filename << " is truncated or corrupt; not loaded\n";
+        flushAll();
+    }
+    return ok;
+}
+
+bool RedisDatabase::loadSection(const char* begin, const char* end, uint64_t keys) {
+    SnapshotReader reader(begin, end);
+    long long now_ms = currentTimeMs();
+    auto now = std::chrono::steady_clock::now();
+    long long expire_at_ms = 0;
+    uint64_t saved_stats[3]; // SNAP_KEY_STATS fields for the next key
+    bool has_stats = false;
+    const LoadLimits limits{hashLimits(), zsetLimits(), getSetMaxIntsetEntries()};
+    // A section normally holds one shard's keys, so that shard is locked once for the
+    // whole section; keys hashing elsewhere (a file from another build) still work.
+    // At most one shard is held at a time, since other sections load in parallel.
+    // Only the section's own shard, the first one met, is sized for its key count.
+    Shard* locked = nullptr;
+    std::unique_lock<std::mutex> lock;
+    bool ok = true;
+    while (ok && !reader.atEnd()) {
+        uint8_t opcode;
+        reader.readByte(opcode);
+        if (opcode == SNAP_EXPIRE_MS) {
+            uint64_t deadline;
+            ok = reader.readFixed64(deadline);
+            expire_at_ms = static_cast<long long>(deadline);
+            continue;
+        }
+        if (opcode == SNAP_KEY_STATS) {
+            ok = reader.readVarint(saved_stats[0]) && reader.readVarint(saved_stats[1]) &&
+                 reader.readVarint(saved_stats[2]);
+            has_stats = true;
+            continue;
+        }
+        std::string_view key_view;
+        RedisObject obj = RedisObject::makeString("");
+        if (!reader.readString(key_view) || !readObject(reader, opcode, obj, limits)) {
+            ok = false;
+            break;
+        }
+        if (expire_at_ms != 0 && expire_at_ms <= now_ms) {
+            expire_at_ms = 0;
+            has_stats = false;
+            continue; // expired while on disk
+        }
+        Shard& shard = shardFor(key_view);
+        if (&shard != locked) {
+            if (locked) {
+                publishMemory(*locked);
+                lock.unlock();
+            }
+            lock = std::unique_lock<std::mutex>(shard.mutex);
+            if (!locked) {
+                shard.keyspace.reserve(keys);
+                shard.predictive_cache.reserve(keys);
+            }
+            locked = &shard;
+        }
+        KeyStats stats;
+        if (has_stats) {
+            stats = readKeyStats(saved_stats[0], saved_stats[1], saved_stats[2], expire_at_ms, now_ms, now);
+        } else { // no metadata saved (an older snapshot): treat the key as just loaded
+            stats = readKeyStats(1, now_ms, 0, expire_at_ms, now_ms, now);
+        }
+        shard.restore(key_view, std::move(obj), expire_at_ms, stats, now);
+        expire_at_ms = 0;
+        has_stats = false;
+    }
+    if (locked) publishMemory(*locked);
+    return ok;
+}
+
+// Reads the whitespace-delimited text format used before the binary snapshot.
+bool RedisDatabase::loadLegacyText(const std::string& filename) {
     std::ifstream ifs(filename, std::ios::binary);
     if (!ifs) return false; // error opening file
 
-    // Clear existing data before loading
-    kv_store.clear();
-    list_store.clear();
-    hash_store.clear();
-    predictive_cache.clear();
+    // Clear existing data before loading. No lock is held while replaying: each
+    // set/rpush/hset below locks the one shard it touches.
+    flushAll();
 
     std::string line;
     while (std::getline(ifs, line)) {
@@ -645,11 +2215,11 @@ bool RedisDatabase::load(const std::string& filename) {
             }
             // Use hset to add elements, ensuring APC records access for the hash key
             for(const auto& pair : hash_map_elements) {
-                hset(key_str, pair.first, pair.second);
+                hset(key_str, {{pair.first, pair.second}});
             }
         }
         // No explicit TTL is dumped or loaded yet, so keys loaded this way won't have TTL unless explicitly set later.
         // This is a simplification; a full Redis RDB would include expiration times.
     }
     return true;
-}
\ No newline at end of file
+}
@@ -1,7 +1,8 @@
-#include "D:\\projects\\Enhanced-Redis\\include\\RedisServer.h"
-#include "D:\\projects\\Enhanced-Redis\\include\\RedisCommandHandler.h"
-#include "D:\\projects\\Enhanced-Redis\\include\\RedisDatabase.h"
-#include "D:\\projects\\Enhanced-Redis\\include\\ThreadPool.h"
+#include "../include/RedisServer.h"
+#include "../include/RedisCommandHandler.h"
+#include "../include/RedisDatabase.h"
+#include "../include/ThreadPool.h"
+#include "../include/AppendOnlyFile.h"
 
 #include <iostream>
 #include <sys/socket.h>
@@ -14,6 +15,9 @@
 #include <vector>
 #include <signal.h> // For signal handling
 #include <atomic>   // For std::atomic
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <cerrno>
 
 static RedisServer *globalServer = nullptr;
 
@@ -39,6 +43,7 @@ void RedisServer::setupSignalHandler()
 RedisServer::RedisServer(int port) : 
     port(port), 
     server_socket(-1), 
+    epoll_fd(-1),
     running(true), 
     thread_pool(std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 4) // Initialize thread pool
 {
@@ -50,6 +55,9 @@ void RedisServer::shutdown()
 {
     running = false; // Atomically set running flag to false
 
+    // Flush and fsync whatever the append-only log still buffers.
+    AppendOnlyFile::getInstance().shutdown();
+
     // Attempt to persist the database before closing the socket.
     // This should ideally be done only once during a graceful shutdown.
     if(RedisDatabase::getInstance().dump("dump.my_rdb")){
@@ -60,14 +68,19 @@ void RedisServer::shutdown()
 
     if (server_socket != -1)
     {
-        // Close the server socket to unblock the accept() call in the run loop.
-        // This will cause accept() to return -1, and the loop will check `running`.
+        // Close the server socket; the event loop notices `running` on its next wakeup.
         close(server_socket);
     }
     std::cout << "Server shutdown complete\n";
     // The thread_pool destructor will implicitly join all threads when RedisServer goes out of scope.
 }
 
+static bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
 void RedisServer::run()
 {
     // Create socket
@@ -100,8 +113,9 @@ void RedisServer::run()
         return;
     }
 
-    // Listen for incoming connections
-    if (listen(server_socket, 10) < 0) // Max 10 pending connections
+    // Listen for incoming connections. The event loop drains the accept queue on
+    // every wakeup, so let the kernel queue as many pending clients as it allows.
+    if (listen(server_socket, SOMAXCONN) < 0)
     {
         std::cerr << "Error listening on server socket\n";
         close(server_socket);
@@ -109,57 +123,212 @@ void RedisServer::run()
     }
     std::cout << "SmartCacheDB Listening on Port " << port << "\n";
 
-    // Load database on startup if dump file exists
-    if(RedisDatabase::getInstance().load("dump.my_rdb")){
-        std::cout << "Database loaded from dump.my_rdb\n";
-    } else {
-        std::cout << "No dump found or load failed; starting with an empty database.\n";
+    // The listening socket and every client socket are non-blocking and multiplexed
+    // through a single epoll instance. Only sockets that actually have data are
+    // handed to the thread pool, so idle clients cost a file descriptor and a
+    // Connection object rather than a whole worker thread.
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0 || !setNonBlocking(server_socket))
+    {
+        std::cerr << "Error creating event loop\n";
+        close(server_socket);
+        return;
+    }
+    epoll_event listenEvent{};
+    listenEvent.events = EPOLLIN;
+    listenEvent.data.ptr = nullptr; // nullptr marks the listening socket
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket, &listenEvent) < 0)
+    {
+        std::cerr << "Error registering server socket\n";
+        close(epoll_fd);
+        close(server_socket);
+        return;
     }
 
-    // Create a single command handler instance, potentially shared by threads if it's thread-safe
-    // If RedisCommandHandler itself needs per-thread state, it should be created per-thread or passed by value.
-    // Given its current structure (processing a single command and returning a string),
-    // passing it by reference to the enqueued task is fine, assuming its internal state is managed via RedisDatabase mutex.
-    RedisCommandHandler cmdHandler; 
-
+    const int MAX_EVENTS = 256;
+    epoll_event events[MAX_EVENTS];
     while (running) // Loop as long as the server is running
+    {
+        // Wake up periodically so a shutdown request is noticed even when idle.
+        int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+        if (ready < 0)
+        {
+            if (errno == EINTR) continue;
+            if (running) std::cerr << "Error waiting for events\n";
+            break;
+        }
+        for (int i = 0; i < ready; ++i)
+        {
+            Connection* conn = static_cast<Connection*>(events[i].data.ptr);
+            if (conn == nullptr)
+            {
+                acceptConnections();
+                continue;
+            }
+            // Client sockets are armed one-shot: no further events are reported for this
+            // connection until the worker re-arms it, so commands from one client are
+            // always executed in order by a single worker at a time.
+            thread_pool.enqueue([this, conn]() {
+                serviceConnection(conn);
+            });
+        }
+    }
+
+    // Let workers finish what they were handed before the connections they hold go
+    // away. Nothing is enqueued any more, so the pool just drains and joins.
+    thread_pool.shutdown();
+
+    // Release remaining clients once the loop stops.
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    for (auto& entry : connections)
+    {
+        close(entry.first);
+    }
+    connections.clear();
+    close(epoll_fd);
+    epoll_fd = -1;
+}
+
+void RedisServer::acceptConnections()
+{
+    while (true)
     {
         sockaddr_in clientAddr{};
         socklen_t clientLen = sizeof(clientAddr);
-        // Accept a new client connection
-        int client_socket = accept(server_socket, (struct sockaddr *)&clientAddr, &clientLen);
-        
+        int client_socket = accept4(server_socket, (struct sockaddr *)&clientAddr, &clientLen, SOCK_NONBLOCK);
         if (client_socket < 0)
         {
-            if (running) // If server is still supposed to be running, it's an error
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && running)
             {
                 std::cerr << "Error accepting client connection\n";
             }
-            // If `running` is false, `accept` failed because `server_socket` was closed.
-            // In this case, it's not an error, just part of shutdown.
-            break; 
+            return; // Accept queue drained (or the server socket was closed during shutdown)
         }
 
-        // Enqueue the client handling task to the thread pool
-        // The lambda captures client_socket by value to ensure each task has its own descriptor.
-        // cmdHandler is captured by reference, assuming it's thread-safe or its critical sections are guarded by RedisDatabase's mutex.
-        thread_pool.enqueue([client_socket, &cmdHandler]() 
+        auto conn = std::make_unique<Connection>(client_socket);
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.ptr = conn.get();
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            connections[client_socket] = std::move(conn);
+        }
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &ev) < 0)
         {
-            char buffer[1024]; // Buffer for receiving client data
-            while(true) // Loop to continuously receive commands from this client
+            std::cerr << "Error registering client connection\n";
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            connections.erase(client_socket);
+            close(client_socket);
+        }
+    }
+}
+
+void RedisServer::serviceConnection(Connection* conn)
+{
+    bool peerClosed = false;
+
+    // Only read more input once earlier replies have been fully handed to the kernel;
+    // a client that stops reading its replies is not allowed to grow them unbounded.
+    if (conn->write_offset == conn->write_buffer.size() && !conn->close_after_write)
+    {
+        // Read what is available, but hand the connection back after a bounded amount
+        // so one client streaming a huge pipeline cannot monopolise a worker. Any bytes
+        // left in the socket re-trigger the (level-triggered) event once re-armed.
+        const size_t READ_CHUNK = 16 * 1024;
+        const size_t MAX_READ_PER_EVENT = 1024 * 1024;
+        size_t readThisEvent = 0;
+        while (readThisEvent < MAX_READ_PER_EVENT)
+        {
+            size_t oldSize = conn->read_buffer.size();
+            conn->read_buffer.resize(oldSize + READ_CHUNK);
+            ssize_t bytes = recv(conn->fd, &conn->read_buffer[oldSize], READ_CHUNK, 0);
+            conn->read_buffer.resize(oldSize + (bytes > 0 ? bytes : 0));
+            if (bytes > 0)
+            {
+                readThisEvent += bytes;
+                continue;
+            }
+            if (bytes < 0 && errno == EINTR) continue;
+            if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            peerClosed = true; // Orderly shutdown by the client or a socket error
+            break;
+        }
+
+        // Execute every complete command in the buffer, in order, and coalesce all
+        // replies into write_buffer so a pipelined batch is answered with one send().
+        // A trailing partial command stays buffered until the rest of it arrives.
+        CommandArgs tokens;
+        while (true)
+        {
+            RespParser::Result r = conn->parser.next(conn->read_buffer, tokens);
+            if (r == RespParser::COMMAND_READY)
             {
-                memset(buffer, 0, sizeof(buffer)); // Clear buffer
-                // Receive data from client
-                int bytes = recv(client_socket, buffer, sizeof(buffer)-1, 0);
-                if(bytes <= 0) break; // Client disconnected or an error occurred
-                
-                std::string request(buffer, bytes); // Construct request string
-                std::string response = cmdHandler.processCommand(request); // Process command
-                send(client_socket, response.c_str(), response.size(), 0); // Send response back to client
+                conn->write_buffer += cmdHandler.processCommand(tokens);
+                continue;
             }
-            close(client_socket); // Close client socket when done
-        });
+            if (r == RespParser::PROTOCOL_ERROR)
+            {
+                conn->write_buffer += "-Error: " + conn->parser.errorMessage() + "\r\n";
+                conn->close_after_write = true;
+            }
+            break;
+        }
+        conn->parser.discardConsumed(conn->read_buffer);
+
+        // Replies may only leave once the writes they acknowledge are in the
+        // append-only log (and fsynced under appendfsync always).
+        AppendOnlyFile::getInstance().commit();
+    }
+
+    if (!flushWrites(conn) || peerClosed ||
+        (conn->close_after_write && conn->write_offset == conn->write_buffer.size()))
+    {
+        closeConnection(conn);
+        return;
     }
-    // The ThreadPool's destructor will automatically join all worker threads when the RedisServer object
-    // is destroyed at the end of its scope (or when `main` exits and globalServer is cleaned up).
-}
\ No newline at end of file
+    rearmConnection(conn);
+}
+
+bool RedisServer::flushWrites(Connection* conn)
+{
+    while (conn->write_offset < conn->write_buffer.size())
+    {
+        ssize_t sent = send(conn->fd, conn->write_buffer.data() + conn->write_offset,
+                            conn->write_buffer.size() - conn->write_offset, MSG_NOSIGNAL);
+        if (sent > 0)
+        {
+            conn->write_offset += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true; // Finish on EPOLLOUT
+        return false;
+    }
+    conn->write_buffer.clear();
+    conn->write_offset = 0;
+    return true;
+}
+
+void RedisServer::rearmConnection(Connection* conn)
+{
+    epoll_event ev{};
+    // While replies are pending wait for the socket to drain; otherwise wait for input.
+    ev.events = (conn->write_offset < conn->write_buffer.size() ? EPOLLOUT : EPOLLIN) | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0)
+    {
+        closeConnection(conn);
+    }
+}
+
+void RedisServer::closeConnection(Connection* conn)
+{
+    int fd = conn->fd;
+    // Hold the lock across close(): once the descriptor is released accept() may hand
+    // out the same number again, and that new entry must not be erased here.
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd); // Destroys conn
+}
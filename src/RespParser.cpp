@@ -0,0 +1,121 @@
+#include "../include/RespParser.h"
+#include <charconv>
+#include <cctype>
+//RESP request framing:
+//*2\r\n$4\r\nPING\r\n$4\r\nTest\r\n
+//*2->array has 2 elements
+//$4-> next string has 4 characters
+
+RespParser::Result RespParser::fail(const std::string& message) {
+    error = "Protocol error: " + message;
+    return PROTOCOL_ERROR;
+}
+
+bool RespParser::readLength(const std::string& buffer, long long& value, bool& malformed) {
+    malformed = false;
+    size_t crlf = buffer.find("\r\n", cursor + 1);
+    if (crlf == std::string::npos) {
+        // A length line is a handful of digits; anything longer is garbage.
+        malformed = buffer.size() - cursor > MAX_INLINE_SIZE;
+        return false;
+    }
+    const char* first = buffer.data() + cursor + 1;
+    const char* last = buffer.data() + crlf;
+    auto res = std::from_chars(first, last, value);
+    if (res.ec != std::errc() || res.ptr != last) {
+        malformed = true;
+        return false;
+    }
+    cursor = crlf + 2;
+    return true;
+}
+
+RespParser::Result RespParser::parseInline(const std::string& buffer, CommandArgs& args) {
+    // Fallback for telnet-style clients: whitespace separated words up to '\n'.
+    size_t nl = buffer.find('\n', cursor);
+    if (nl == std::string::npos) {
+        if (buffer.size() - cursor > MAX_INLINE_SIZE) return fail("too big inline request");
+        return NEED_MORE;
+    }
+    size_t end = (nl > cursor && buffer[nl - 1] == '\r') ? nl - 1 : nl;
+    size_t pos = cursor;
+    while (pos < end) {
+        while (pos < end && std::isspace(static_cast<unsigned char>(buffer[pos]))) pos++;
+        size_t start = pos;
+        while (pos < end && !std::isspace(static_cast<unsigned char>(buffer[pos]))) pos++;
+        if (pos > start) args.push_back(std::string_view(buffer.data() + start, pos - start));
+    }
+    cursor = consumed = nl + 1;
+    return args.empty() ? NEED_MORE : COMMAND_READY;
+}
+
+RespParser::Result RespParser::next(const std::string& buffer, CommandArgs& args) {
+    args.clear();
+    while (true) {
+        if (args_remaining < 0) {
+            // Waiting for the start of a new command.
+            if (cursor >= buffer.size()) return NEED_MORE;
+            if (buffer[cursor] != '*') {
+                size_t line_start = cursor;
+                Result r = parseInline(buffer, args);
+                if (r == NEED_MORE && cursor != line_start) continue; // skipped a blank line
+                return r;
+            }
+            long long count;
+            bool malformed;
+            if (!readLength(buffer, count, malformed)) {
+                return malformed ? fail("invalid multibulk length") : NEED_MORE;
+            }
+            if (count > MAX_MULTIBULK_LEN) return fail("invalid multibulk length");
+            if (count <= 0) { // Empty arrays are ignored, as in Redis
+                consumed = cursor;
+                continue;
+            }
+            args_remaining = count;
+            arg_spans.clear();
+            arg_spans.reserve(static_cast<size_t>(count));
+        }
+
+        while (args_remaining > 0) {
+            if (bulk_len < 0) {
+                if (cursor >= buffer.size()) return NEED_MORE;
+                if (buffer[cursor] != '$') {
+                    return fail(std::string("expected '$', got '") + buffer[cursor] + "'");
+                }
+                long long len;
+                bool malformed;
+                if (!readLength(buffer, len, malformed)) {
+                    return malformed ? fail("invalid bulk length") : NEED_MORE;
+                }
+                if (len < 0 || len > MAX_BULK_LEN) return fail("invalid bulk length");
+                bulk_len = len;
+            }
+            // Wait until the whole payload and its trailing CRLF have arrived.
+            if (buffer.size() - cursor < static_cast<size_t>(bulk_len) + 2) return NEED_MORE;
+            size_t end = cursor + static_cast<size_t>(bulk_len);
+            if (buffer[end] != '\r' || buffer[end + 1] != '\n') return fail("bulk string not terminated by CRLF");
+            arg_spans.emplace_back(cursor, static_cast<size_t>(bulk_len));
+            cursor = end + 2;
+            bulk_len = -1;
+            args_remaining--;
+        }
+
+        // Command complete.
+        for (const auto& span : arg_spans) {
+            args.push_back(std::string_view(buffer.data() + span.first, span.second));
+        }
+        args_remaining = -1;
+        consumed = cursor;
+        return COMMAND_READY;
+    }
+}
+
+void RespParser::discardConsumed(std::string& buffer) {
+    if (consumed == 0) return;
+    buffer.erase(0, consumed);
+    cursor -= consumed;
+    for (auto& span : arg_spans) {
+        span.first -= consumed;
+    }
+    consumed = 0;
+}
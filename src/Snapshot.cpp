@@ -0,0 +1,218 @@
+#include "../include/Snapshot.h"
+#include <cstring>
+#include <algorithm>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+struct Crc32cTable {
+    uint32_t entries[256];
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1; // reflected Castagnoli polynomial
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+uint32_t crc32cSoftware(uint32_t crc, const unsigned char* p, size_t len) {
+    static const Crc32cTable table;
+    while (len--) {
+        crc = table.entries[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(uint32_t crc, const unsigned char* p, size_t len) {
+    uint64_t c = crc;
+    while (len >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        c = _mm_crc32_u64(c, word);
+        p += 8;
+        len -= 8;
+    }
+    uint32_t c32 = static_cast<uint32_t>(c);
+    while (len--) {
+        c32 = _mm_crc32_u8(c32, *p++);
+    }
+    return c32;
+}
+#endif
+
+} // namespace
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t len) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+#if defined(__x86_64__)
+    static const bool hardware = __builtin_cpu_supports("sse4.2");
+    if (hardware) {
+        return ~crc32cHardware(crc, p, len);
+    }
+#endif
+    return ~crc32cSoftware(crc, p, len);
+}
+
+// ---- SnapshotWriter ----
+
+void SnapshotWriter::writeHeader() {
+    buffer.append(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    buffer.push_back(static_cast<char>(SNAPSHOT_VERSION));
+}
+
+void SnapshotWriter::writeVarint(uint64_t v) {
+    while (v >= 0x80) {
+        buffer.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    buffer.push_back(static_cast<char>(v));
+    maybeFlush();
+}
+
+void SnapshotWriter::writeFixed64(uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        buffer.push_back(static_cast<char>(v >> (8 * i)));
+    }
+    maybeFlush();
+}
+
+void SnapshotWriter::writeString(std::string_view s) {
+    writeVarint(s.size());
+    if (s.size() >= BUFFER_SIZE) {
+        flush(); // large values go straight to the file instead of through the buffer
+        crc = crc32c(crc, s.data(), s.size());
+        if (std::fwrite(s.data(), 1, s.size(), file) != s.size()) failed = true;
+        written += s.size();
+        return;
+    }
+    buffer.append(s.data(), s.size());
+    maybeFlush();
+}
+
+void SnapshotWriter::flush() {
+    if (buffer.empty()) return;
+    crc = crc32c(crc, buffer.data(), buffer.size());
+    if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) failed = true;
+    written += buffer.size();
+    buffer.clear();
+}
+
+void SnapshotWriter::writeSectionIndex(const std::vector<SnapshotSection>& sections) {
+    uint64_t index_offset = bytesWritten();
+    writeByte(SNAP_SECTION_INDEX);
+    writeVarint(sections.size());
+    for (const SnapshotSection& section : sections) {
+        writeFixed64(section.offset);
+        writeVarint(section.keys);
+    }
+    writeFixed64(index_offset);
+}
+
+bool SnapshotWriter::finish() {
+    buffer.push_back(static_cast<char>(SNAP_EOF));
+    flush();
+    unsigned char trailer[4];
+    for (int i = 0; i < 4; ++i) {
+        trailer[i] = static_cast<unsigned char>(crc >> (8 * i));
+    }
+    if (std::fwrite(trailer, 1, sizeof(trailer), file) != sizeof(trailer)) failed = true;
+    written += sizeof(trailer);
+    if (std::fflush(file) != 0) failed = true;
+    return !failed;
+}
+
+// ---- SnapshotReader ----
+
+bool SnapshotReader::readByte(uint8_t& b) {
+    if (pos == end) return false;
+    b = static_cast<uint8_t>(*pos++);
+    return true;
+}
+
+bool SnapshotReader::readVarint(uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t b;
+        if (!readByte(b)) return false;
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) return true;
+    }
+    return false; // more than 10 bytes: not a valid varint
+}
+
+bool SnapshotReader::readFixed64(uint64_t& v) {
+    if (end - pos < 8) return false;
+    v = 0;
+    for (int i = 0; i < 8; ++i) {
+        v |= static_cast<uint64_t>(static_cast<unsigned char>(pos[i])) << (8 * i);
+    }
+    pos += 8;
+    return true;
+}
+
+bool SnapshotReader::readString(std::string_view& s) {
+    uint64_t len;
+    if (!readVarint(len) || len > static_cast<uint64_t>(end - pos)) return false;
+    s = std::string_view(pos, len);
+    pos += len;
+    return true;
+}
+
+bool parseSnapshotLayout(const char* data, size_t size, SnapshotLayout& layout) {
+    const size_t header = sizeof(SNAPSHOT_MAGIC) + 1;
+    const size_t trailer = 1 + 4; // SNAP_EOF, crc
+    if (size < header + trailer || std::memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        return false;
+    }
+    uint8_t version = static_cast<uint8_t>(data[sizeof(SNAPSHOT_MAGIC)]);
+    if (static_cast<uint8_t>(data[size - trailer]) != SNAP_EOF) return false;
+
+    layout.checksummed = size - 4;
+    const unsigned char* c = reinterpret_cast<const unsigned char*>(data + size - 4);
+    layout.stored_crc = c[0] | (c[1] << 8) | (c[2] << 16) | (static_cast<uint32_t>(c[3]) << 24);
+    layout.sections.clear();
+
+    if (version == 1) {
+        layout.sections.push_back({data + header, data + size - trailer, 0});
+        return true;
+    }
+    if (version < 2 || version > SNAPSHOT_VERSION || size < header + trailer + 8) return false;
+
+    uint64_t index_offset;
+    SnapshotReader tail(data + size - trailer - 8, data + size - trailer);
+    if (!tail.readFixed64(index_offset) || index_offset < header || index_offset > size - trailer - 8) {
+        return false;
+    }
+    const char* index_begin = data + index_offset;
+    SnapshotReader index(index_begin, data + size - trailer - 8);
+    uint8_t opcode;
+    uint64_t count;
+    if (!index.readByte(opcode) || opcode != SNAP_SECTION_INDEX || !index.readVarint(count) ||
+        count > index_offset) {
+        return false;
+    }
+    std::vector<SnapshotSection> sections(count);
+    for (SnapshotSection& section : sections) {
+        if (!index.readFixed64(section.offset) || !index.readVarint(section.keys)) return false;
+    }
+    if (!index.atEnd()) return false;
+    // Sections are contiguous: each ends where the next begins, the last at the index.
+    // Key counts size tables before the CRC is verified, so they must fit the section.
+    uint64_t expected = header;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        uint64_t next = i + 1 < sections.size() ? sections[i + 1].offset : index_offset;
+        if (sections[i].offset != expected || next < expected) return false;
+        if (sections[i].keys > (next - expected) / SNAPSHOT_MIN_RECORD_SIZE) return false;
+        layout.sections.push_back({data + sections[i].offset, data + next, sections[i].keys});
+        expected = next;
+    }
+    return expected == index_offset;
+}
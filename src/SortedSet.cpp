@@ -0,0 +1,214 @@
+#include "../include/SortedSet.h"
+#include "../include/RedisObject.h" // mallocSize, stringHeapBytes
+#include <charconv>
+#include <cmath>
+#include <new>
+#include <random>
+
+SortedSet::SortedSet() : header(createNode(MAX_LEVEL, std::string_view(), 0)) {
+    header->backward = nullptr;
+}
+
+SortedSet::~SortedSet() {
+    Node* n = header->levels()[0].forward;
+    while (n) {
+        Node* next = n->levels()[0].forward;
+        destroyNode(n);
+        n = next;
+    }
+    destroyNode(header);
+}
+
+size_t SortedSet::nodeBytes(int levels) {
+    return mallocSize(sizeof(Node) + levels * sizeof(Level));
+}
+
+SortedSet::Node* SortedSet::createNode(int levels, std::string_view member, double score) {
+    void* mem = ::operator new(sizeof(Node) + levels * sizeof(Level));
+    Node* n = new (mem) Node{std::string(member), score, nullptr, levels};
+    for (int i = 0; i < levels; ++i) {
+        n->levels()[i] = Level{nullptr, 0};
+    }
+    return n;
+}
+
+void SortedSet::destroyNode(Node* n) {
+    n->~Node();
+    ::operator delete(n);
+}
+
+int SortedSet::randomLevel() {
+    static thread_local std::mt19937 rng{std::random_device{}()};
+    int levels = 1;
+    while (levels < MAX_LEVEL && (rng() & 3) == 0) {
+        ++levels;
+    }
+    return levels;
+}
+
+bool SortedSet::score(std::string_view member, double& score) const {
+    const double* found = scores.find(member);
+    if (found == nullptr) return false;
+    score = *found;
+    return true;
+}
+
+bool SortedSet::set(std::string_view member, double score) {
+    auto res = scores.emplace(member, double(score));
+    if (res.second) {
+        bytes += stringHeapBytes(member.size());
+        insertNode(member, score);
+        return true;
+    }
+    double current = *res.first;
+    if (current != score) {
+        *res.first = score;
+        eraseNode(member, current);
+        insertNode(member, score);
+    }
+    return false;
+}
+
+bool SortedSet::erase(std::string_view member) {
+    std::optional<double> score = scores.take(member);
+    if (!score) return false;
+    bytes -= stringHeapBytes(member.size());
+    eraseNode(member, *score);
+    return true;
+}
+
+void SortedSet::insertNode(std::string_view member, double score) {
+    Node* update[MAX_LEVEL];
+    size_t rank[MAX_LEVEL]; // elements before update[i]
+    Node* x = header;
+    for (int i = level - 1; i >= 0; --i) {
+        rank[i] = i == level - 1 ? 0 : rank[i + 1];
+        while (x->levels()[i].forward && before(x->levels()[i].forward, score, member)) {
+            rank[i] += x->levels()[i].span;
+            x = x->levels()[i].forward;
+        }
+        update[i] = x;
+    }
+    int levels = randomLevel();
+    if (levels > level) {
+        for (int i = level; i < levels; ++i) {
+            rank[i] = 0;
+            update[i] = header;
+            update[i]->levels()[i].span = length;
+        }
+        level = levels;
+    }
+    x = createNode(levels, member, score);
+    bytes += nodeBytes(levels) + stringHeapBytes(x->member);
+    for (int i = 0; i < levels; ++i) {
+        x->levels()[i].forward = update[i]->levels()[i].forward;
+        update[i]->levels()[i].forward = x;
+        // update[i] now spans up to x; x takes over the rest of update[i]'s old span
+        x->levels()[i].span = update[i]->levels()[i].span - (rank[0] - rank[i]);
+        update[i]->levels()[i].span = (rank[0] - rank[i]) + 1;
+    }
+    // Links above x's height now step over one more element
+    for (int i = levels; i < level; ++i) {
+        update[i]->levels()[i].span++;
+    }
+    x->backward = update[0] == header ? nullptr : update[0];
+    Node* next = x->levels()[0].forward;
+    if (next) next->backward = x;
+    ++length;
+}
+
+void SortedSet::eraseNode(std::string_view member, double score) {
+    Node* update[MAX_LEVEL];
+    Node* x = header;
+    for (int i = level - 1; i >= 0; --i) {
+        while (x->levels()[i].forward && before(x->levels()[i].forward, score, member)) {
+            x = x->levels()[i].forward;
+        }
+        update[i] = x;
+    }
+    x = x->levels()[0].forward; // the element itself: scores and nodes never disagree
+    for (int i = 0; i < level; ++i) {
+        if (update[i]->levels()[i].forward == x) {
+            update[i]->levels()[i].span += x->levels()[i].span - 1;
+            update[i]->levels()[i].forward = x->levels()[i].forward;
+        } else {
+            update[i]->levels()[i].span--;
+        }
+    }
+    Node* next = x->levels()[0].forward;
+    if (next) next->backward = x->backward;
+    while (level > 1 && header->levels()[level - 1].forward == nullptr) {
+        --level;
+    }
+    bytes -= nodeBytes(x->height) + stringHeapBytes(x->member);
+    --length;
+    destroyNode(x);
+}
+
+bool SortedSet::rank(std::string_view member, size_t& rank) const {
+    double s;
+    if (!score(member, s)) return false;
+    size_t traversed = 0;
+    const Node* x = header;
+    for (int i = level - 1; i >= 0; --i) {
+        while (x->levels()[i].forward && before(x->levels()[i].forward, s, member)) {
+            traversed += x->levels()[i].span;
+            x = x->levels()[i].forward;
+        }
+    }
+    rank = traversed; // x is the last element before member
+    return true;
+}
+
+size_t SortedSet::countBelow(const ScoreRange& range) const {
+    size_t traversed = 0;
+    const Node* x = header;
+    for (int i = level - 1; i >= 0; --i) {
+        while (x->levels()[i].forward && !range.aboveMin(x->levels()[i].forward->score)) {
+            traversed += x->levels()[i].span;
+            x = x->levels()[i].forward;
+        }
+    }
+    return traversed;
+}
+
+size_t SortedSet::countUpTo(const ScoreRange& range) const {
+    size_t traversed = 0;
+    const Node* x = header;
+    for (int i = level - 1; i >= 0; --i) {
+        while (x->levels()[i].forward && range.belowMax(x->levels()[i].forward->score)) {
+            traversed += x->levels()[i].span;
+            x = x->levels()[i].forward;
+        }
+    }
+    return traversed;
+}
+
+const SortedSet::Node* SortedSet::nodeAt(size_t rank) const {
+    size_t traversed = 0; // 1-based rank of x
+    const Node* x = header;
+    for (int i = level - 1; i >= 0; --i) {
+        while (x->levels()[i].forward && traversed + x->levels()[i].span <= rank + 1) {
+            traversed += x->levels()[i].span;
+            x = x->levels()[i].forward;
+        }
+        if (traversed == rank + 1) return x;
+    }
+    return x;
+}
+
+size_t SortedSet::memoryUsage() const {
+    return mallocSize(sizeof(SortedSet)) + nodeBytes(MAX_LEVEL) + scores.tableBytes() + bytes;
+}
+
+bool SortedSet::parseScore(std::string_view text, double& score) {
+    if (!text.empty() && text[0] == '+') text.remove_prefix(1); // from_chars takes no '+'
+    if (text.empty()) return false;
+    auto res = std::from_chars(text.data(), text.data() + text.size(), score);
+    return res.ec == std::errc() && res.ptr == text.data() + text.size() && !std::isnan(score);
+}
+
+std::string_view SortedSet::formatScore(double score, char (&buf)[SCORE_STR_SIZE]) {
+    auto res = std::to_chars(buf, buf + SCORE_STR_SIZE, score);
+    return std::string_view(buf, res.ptr - buf);
+}
@@ -0,0 +1,82 @@
+#include "../include/StringMatch.h"
+#include <cctype>
+#include <utility>
+
+namespace {
+
+char fold(char c, bool nocase) {
+    return nocase ? static_cast<char>(std::tolower(static_cast<unsigned char>(c))) : c;
+}
+
+// Matches the single-character token at pattern[p] (not '*') against c. On success
+// sets next to the index just past the token.
+bool matchOne(std::string_view pattern, size_t p, char c, size_t& next, bool nocase) {
+    c = fold(c, nocase);
+    switch (pattern[p]) {
+        case '?':
+            next = p + 1;
+            return true;
+        case '\\':
+            if (p + 1 < pattern.size()) {
+                next = p + 2;
+                return fold(pattern[p + 1], nocase) == c;
+            }
+            next = p + 1;
+            return c == '\\';
+        case '[': {
+            ++p;
+            bool negate = p < pattern.size() && pattern[p] == '^';
+            if (negate) ++p;
+            bool found = false;
+            // An unterminated class runs to the end of the pattern, as in Redis
+            while (p < pattern.size() && pattern[p] != ']') {
+                if (pattern[p] == '\\' && p + 1 < pattern.size()) {
+                    found |= fold(pattern[p + 1], nocase) == c;
+                    p += 2;
+                } else if (p + 2 < pattern.size() && pattern[p + 1] == '-' && pattern[p + 2] != ']') {
+                    char lo = fold(pattern[p], nocase), hi = fold(pattern[p + 2], nocase);
+                    if (lo > hi) std::swap(lo, hi);
+                    found |= c >= lo && c <= hi;
+                    p += 3;
+                } else {
+                    found |= fold(pattern[p], nocase) == c;
+                    ++p;
+                }
+            }
+            next = p < pattern.size() ? p + 1 : p;
+            return found != negate;
+        }
+        default:
+            next = p + 1;
+            return fold(pattern[p], nocase) == c;
+    }
+}
+
+} // namespace
+
+bool stringMatch(std::string_view pattern, std::string_view str, bool nocase) {
+    size_t p = 0, s = 0;
+    size_t star = std::string_view::npos; // pattern index just past the latest '*'
+    size_t star_s = 0;                    // where in str that '*' currently stops
+    while (s < str.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            while (p < pattern.size() && pattern[p] == '*') ++p;
+            if (p == pattern.size()) return true;
+            star = p;
+            star_s = s;
+            continue;
+        }
+        size_t next;
+        if (p < pattern.size() && matchOne(pattern, p, str[s], next, nocase)) {
+            p = next;
+            ++s;
+            continue;
+        }
+        if (star == std::string_view::npos) return false;
+        // Let the latest '*' swallow one more character and retry from there
+        p = star;
+        s = ++star_s;
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
@@ -1,4 +1,4 @@
-#include "D:\\projects\\Enhanced-Redis\\include\\ThreadPool.h"
+#include "../include/ThreadPool.h"
 
 ThreadPool::ThreadPool(size_t num_threads) : stop(false) {
     for (size_t i = 0; i < num_threads; ++i) {
@@ -23,12 +23,18 @@ ThreadPool::ThreadPool(size_t num_threads) : stop(false) {
 }
 
 ThreadPool::~ThreadPool() {
+    shutdown();
+}
+
+void ThreadPool::shutdown() {
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
         stop = true;
     }
     condition.notify_all();
     for (std::thread& worker : workers) {
-        worker.join();
+        if (worker.joinable()) {
+            worker.join();
+        }
     }
 }
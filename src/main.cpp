@@ -1,33 +1,92 @@
 #include<iostream>
 #include<thread>
 #include<chrono>
+#include<string>
 #include "../include/RedisServer.h"
 #include "../include/RedisDatabase.h"
+#include "../include/RedisCommandHandler.h"
+#include "../include/AppendOnlyFile.h"
+#include <unistd.h>
 int main(int argc,char* argv[]){
    int port =6379;//default port
-   if(argc>=2)port=std::stoi(argv[1]);//checking if server wants the user wants to start server or not.if not we use default.
-   if(RedisDatabase::getInstance().load("dump.my_rdb")){
+   if(argc>=2 && argv[1][0]!='-')port=std::stoi(argv[1]);//checking if server wants the user wants to start server or not.if not we use default.
+
+   //optional memory limit: --maxmemory <bytes|100mb|1gb> --maxmemory-policy <allkeys-apc|allkeys-random|noeviction>
+   //optional command log:  --appendonly <yes|no> --appendfsync <always|everysec|no>
+   bool appendonly=false;
+   AofFsync appendfsync=AofFsync::EVERYSEC;
+   for(int i=1;i+1<argc;i++){
+    std::string option=argv[i];
+    if(option=="--maxmemory"){
+        size_t bytes=0;
+        if(!RedisDatabase::parseMemorySize(argv[++i],bytes)){
+            std::cerr<<"Invalid --maxmemory value: "<<argv[i]<<"\n";
+            return 1;
+        }
+        RedisDatabase::getInstance().setMaxmemory(bytes);
+    }else if(option=="--maxmemory-policy"){
+        if(!RedisDatabase::getInstance().setMaxmemoryPolicy(argv[++i])){
+            std::cerr<<"Unknown --maxmemory-policy: "<<argv[i]<<"\n";
+            return 1;
+        }
+    }else if(option=="--appendonly"){
+        appendonly=std::string(argv[++i])=="yes";
+    }else if(option=="--appendfsync"){
+        if(!AppendOnlyFile::parseFsyncPolicy(argv[++i],appendfsync)){
+            std::cerr<<"Unknown --appendfsync: "<<argv[i]<<"\n";
+            return 1;
+        }
+    }
+   }
+   //with the append-only log on it is the most complete copy of the data, so it wins over the snapshot
+   bool aofExists=appendonly && access("appendonly.aof",F_OK)==0;
+   if(aofExists){
+    RedisCommandHandler replayHandler;
+    if(!AppendOnlyFile::replay("appendonly.aof",replayHandler)){
+        std::cerr<<"appendonly.aof is corrupt; refusing to start\n";
+        return 1;
+    }
+   }else if(RedisDatabase::getInstance().load("dump.my_rdb")){
     std::cout<<"Database loaded from dump.my_rdb\n";
    }else{
     std::cout<<"No dump found or load failed; starting with an empty database.\n";
    }
+   if(appendonly){
+    AppendOnlyFile& aof=AppendOnlyFile::getInstance();
+    if(!aof.open("appendonly.aof",appendfsync)){
+        std::cerr<<"Cannot open appendonly.aof\n";
+        return 1;
+    }
+    //a new log must start from the data loaded from the snapshot
+    if(!aofExists)aof.rewriteInBackground();
+   }
    RedisServer server(port);
 
-   //background persistance: dump the database every 300 seconds.(5*60 save database)
+   //background persistance: snapshot the database every 300 seconds.(5*60 save database)
+   //bgsave forks a child to write the file, so clients are only paused for the fork;
+   //the outcome is logged when the child finishes.
    std::thread persistanceThread([](){
     while(true){
         std::this_thread::sleep_for(std::chrono::seconds(300));
-        //dump the database 
-        if(!RedisDatabase::getInstance().dump("dump.my_rdb")){
-            std::cerr<<"Error dumping database\n";
+        if(!RedisDatabase::getInstance().bgsave("dump.my_rdb")){
+            std::cerr<<"Background save not started (already running or fork failed)\n";
         }else {
-            std::cout<<"Database dumped successfully\n";
+            std::cout<<"Background saving started\n";
         }
-
     }
    });
    persistanceThread.detach();
 
+   //active expiration: every 100ms spend at most 25ms deleting keys whose TTL has passed,
+   //so keys that are never read again do not stay in memory.
+   std::thread expiryThread([](){
+    while(true){
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        RedisDatabase::getInstance().activeExpireCycle(25);
+    }
+   });
+   expiryThread.detach();
+
    server.run();
     return 0;
 }
\ No newline at end of file
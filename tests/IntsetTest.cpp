@@ -0,0 +1,104 @@
+// Intset and the sorted-array set kernels. Built and run by `make test`.
+#include "../include/Intset.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+
+template <typename T>
+std::vector<T> randomSorted(std::mt19937_64& rng, size_t n, int64_t range, int64_t offset) {
+    std::set<T> values;
+    std::uniform_int_distribution<int64_t> dist(0, range - 1);
+    while (values.size() < n && values.size() < static_cast<size_t>(range)) {
+        values.insert(static_cast<T>(dist(rng) + offset));
+    }
+    return std::vector<T>(values.begin(), values.end());
+}
+
+// Compares the kernels with the standard algorithms. Lengths run through every
+// remainder modulo the lane widths and past the galloping ratio, and the value
+// ranges from dense (long runs of matches across block boundaries) to sparse.
+template <typename T>
+void testKernels(int64_t offset) {
+    std::mt19937_64 rng(sizeof(T) * 1000 + (offset != 0));
+    const size_t lengths[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 64, 100, 257, 1000, 4099};
+    const int64_t ranges[] = {8, 64, 1000, 100000};
+    std::vector<T> out, expected;
+    for (int round = 0; round < 4; ++round) {
+        for (size_t na : lengths) {
+            for (size_t nb : lengths) {
+                for (int64_t range : ranges) {
+                    std::vector<T> a = randomSorted<T>(rng, na, range, offset);
+                    std::vector<T> b = randomSorted<T>(rng, nb, range, offset);
+
+                    out.assign(a.size(), 0);
+                    out.resize(intersectSorted(a.data(), a.size(), b.data(), b.size(), out.data()));
+                    expected.clear();
+                    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+                    assert(out == expected);
+
+                    out.assign(a.size(), 0);
+                    out.resize(differenceSorted(a.data(), a.size(), b.data(), b.size(), out.data()));
+                    expected.clear();
+                    std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+                    assert(out == expected);
+
+                    out.assign(a.size() + b.size(), 0);
+                    out.resize(unionSorted(a.data(), a.size(), b.data(), b.size(), out.data()));
+                    expected.clear();
+                    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+                    assert(out == expected);
+                }
+            }
+        }
+    }
+}
+
+// Insert/erase against a model, widening to 64 bits and reading back either width.
+void testIntset() {
+    Intset set;
+    std::set<int64_t> model;
+    std::mt19937_64 rng(3);
+    for (int i = 0; i < 20000; ++i) {
+        int64_t v = static_cast<int64_t>(rng() % 2000) - 1000;
+        if (i == 10000) v = int64_t(1) << 40; // forces the 64-bit array
+        if (rng() % 3 == 0) {
+            assert(set.erase(v) == (model.erase(v) == 1));
+        } else {
+            assert(set.insert(v) == model.insert(v).second);
+        }
+        assert(set.size() == model.size());
+        if (i < 10000) assert(!set.wide()); // every value so far fits 32 bits
+    }
+    assert(set.wide());
+    for (int64_t v = -1001; v <= 1001; ++v) {
+        assert(set.contains(v) == (model.count(v) == 1));
+    }
+    std::vector<int64_t> values;
+    set.forEach([&values](int64_t v) { values.push_back(v); });
+    assert(values == std::vector<int64_t>(model.begin(), model.end()));
+
+    Intset narrow;
+    narrow.assignSorted({-3, 1, 5});
+    assert(!narrow.wide());
+    std::vector<int64_t> scratch;
+    const int64_t* widened = narrow.data(scratch);
+    assert(widened[0] == -3 && widened[1] == 1 && widened[2] == 5);
+}
+
+} // namespace
+
+int main() {
+    testKernels<int32_t>(0);
+    testKernels<int32_t>(-500); // negative values
+    testKernels<int64_t>(0);
+    testKernels<int64_t>(int64_t(1) << 40); // values whose high halves match but low halves differ
+    testIntset();
+    std::cout << "IntsetTest passed\n";
+    return 0;
+}
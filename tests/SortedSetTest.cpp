@@ -0,0 +1,73 @@
+// SortedSet: skiplist order, ranks and byte accounting. Built and run by `make test`.
+#include "../include/SortedSet.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Byte accounting must give back everything a member took, whatever its node's
+// height, so memoryUsage() returns to the empty set's after insert, update and erase.
+void testMemoryReturnsToBaseline() {
+    SortedSet set;
+    const size_t baseline = set.memoryUsage();
+    std::mt19937 rng(1);
+    for (int i = 0; i < 1000; ++i) {
+        set.set("member:" + std::to_string(i), rng() % 100);
+    }
+    const size_t filled = set.memoryUsage();
+    assert(filled > baseline);
+    for (int i = 0; i < 100000; ++i) {
+        set.set("member:" + std::to_string(rng() % 1000), rng() % 100); // moves the node
+    }
+    assert(set.size() == 1000);
+    for (int i = 0; i < 1000; ++i) {
+        assert(set.erase("member:" + std::to_string(i)));
+    }
+    assert(set.size() == 0);
+    assert(set.memoryUsage() == baseline);
+}
+
+// Order, ranks and rank ranges against a model, across updates and erases.
+void testMatchesModel() {
+    SortedSet set;
+    std::map<std::string, double> scores;
+    std::mt19937 rng(2);
+    for (int i = 0; i < 20000; ++i) {
+        std::string member = "m" + std::to_string(rng() % 500);
+        if (rng() % 4 == 0) {
+            assert(set.erase(member) == (scores.erase(member) == 1));
+        } else {
+            double score = rng() % 50;
+            assert(set.set(member, score) == (scores.count(member) == 0));
+            scores[member] = score;
+        }
+    }
+    std::vector<std::pair<double, std::string>> sorted;
+    for (const auto& [member, score] : scores) sorted.emplace_back(score, member);
+    std::sort(sorted.begin(), sorted.end());
+    assert(set.size() == sorted.size());
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        size_t rank;
+        assert(set.rank(sorted[i].second, rank) && rank == i);
+    }
+    size_t i = 0;
+    set.forEach([&](std::string_view member, double score) {
+        assert(member == sorted[i].second && score == sorted[i].first);
+        ++i;
+    });
+    assert(i == sorted.size());
+}
+
+} // namespace
+
+int main() {
+    testMemoryReturnsToBaseline();
+    testMatchesModel();
+    std::cout << "SortedSetTest passed\n";
+    return 0;
+}